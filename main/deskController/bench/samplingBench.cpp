@@ -0,0 +1,340 @@
+﻿#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Banc d'essai hors machine de la chaîne d'échantillonnage : images BGRA synthétiques
+// (1080p, 1440p, 4K, 8K, avec un RowPitch aligné comme celui des textures de staging),
+// puis remplissage des bordures, moyenne par zone, tables de couleurs et encodage delta
+// sur une matrice ledX / ledY / keepPixels / reduction / filtre. Affiche ns par image et par
+// étape, et octets envoyés sur le port série par image.
+//
+// Aucune dépendance à Windows : les modules inclus sont ceux du chemin de capture.
+//   Linux : g++ -O2 -std=c++14 -pthread bench/samplingBench.cpp -o samplingBench
+//   MSVC  : cl /O2 /EHsc bench\samplingBench.cpp
+// Options : --quick (1080p et 4K, moins d'itérations), --frames N
+
+#define USE_PARALLEL 1
+#define USE_FRAMED_PROTOCOL 1
+
+#include "../samplingEngine.cpp"
+#include "../borderAtlas.cpp"
+#include "../ledProtocol.cpp"
+#include "../changeDetector.cpp"
+#include "../colorPipeline.cpp"
+
+struct BenchResolution {
+    const char* name;
+    uint32_t width;
+    uint32_t height;
+};
+
+struct BenchConfig {
+    int ledX;
+    int ledY;
+    int keepPixels;
+    float reduction;
+    SamplingFilter filter;
+};
+
+// Image BGRA synthétique : dégradés, bruit de grain et un bloc qui se déplace le long
+// des bords d'une image à l'autre (comme une fenêtre ou une vidéo)
+class syntheticFrame {
+
+private:
+    uint32_t seed = 12345;
+
+    uint32_t nextRandom() {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    }
+
+public:
+    uint32_t width;
+    uint32_t height;
+    uint32_t rowPitch;
+    std::vector<uint8_t> pixels;
+
+    syntheticFrame(uint32_t frameWidth, uint32_t frameHeight)
+        : width(frameWidth), height(frameHeight) {
+        // Les textures de staging D3D11 alignent le RowPitch ; 256 octets plus une ligne de
+        // cache de bourrage couvre les cas vus sur les pilotes courants
+        rowPitch = ((width * 4 + 255) / 256) * 256 + 64;
+        pixels.assign(static_cast<size_t>(rowPitch) * height, 0);
+
+        for (uint32_t y = 0; y < height; ++y) {
+            uint8_t* row = pixels.data() + static_cast<size_t>(y) * rowPitch;
+            for (uint32_t x = 0; x < width; ++x) {
+                row[x * 4 + 0] = static_cast<uint8_t>((x * 255) / width);
+                row[x * 4 + 1] = static_cast<uint8_t>((y * 255) / height);
+                row[x * 4 + 2] = static_cast<uint8_t>(((x + y) * 127) / (width + height) + (nextRandom() & 0x7));
+                row[x * 4 + 3] = 0xFF;
+            }
+        }
+    }
+
+    // Fait évoluer l'image : bloc mobile le long du bord haut puis du bord droit, et
+    // grain sur quelques lignes
+    void advance(int frameIndex) {
+        const uint32_t block = std::min(width, height) / 8;
+        const uint32_t perimeter = width + height;
+        const uint32_t position = static_cast<uint32_t>(frameIndex * 97) % perimeter;
+        uint32_t x0 = 0;
+        uint32_t y0 = 0;
+        if (position < width) {
+            x0 = std::min(position, width - block);
+        }
+        else {
+            x0 = width - block;
+            y0 = std::min(position - width, height - block);
+        }
+        const uint8_t shade = static_cast<uint8_t>(frameIndex * 37);
+        for (uint32_t y = y0; y < y0 + block; ++y) {
+            uint8_t* row = pixels.data() + static_cast<size_t>(y) * rowPitch + static_cast<size_t>(x0) * 4;
+            for (uint32_t x = 0; x < block; ++x) {
+                row[x * 4 + 0] = shade;
+                row[x * 4 + 1] = static_cast<uint8_t>(255 - shade);
+                row[x * 4 + 2] = static_cast<uint8_t>(shade / 2);
+            }
+        }
+        for (int i = 0; i < 16; ++i) {
+            const uint32_t y = nextRandom() % height;
+            uint8_t* row = pixels.data() + static_cast<size_t>(y) * rowPitch;
+            for (uint32_t x = 0; x < width; x += 3) {
+                row[x * 4 + 1] = static_cast<uint8_t>(row[x * 4 + 1] ^ (nextRandom() & 0x3));
+            }
+        }
+    }
+
+    FrameView view() const {
+        FrameView frame;
+        frame.data = pixels.data();
+        frame.rowPitch = rowPitch;
+        frame.width = width;
+        frame.height = height;
+        return frame;
+    }
+};
+
+// Temps cumulés d'une configuration
+struct BenchTotals {
+    double buffered = 0;  // remplissage des bordures + moyenne (référence)
+    double fused = 0;     // moyenne directe depuis l'image
+    double atlas = 0;     // copie des bandes dans l'atlas + moyenne depuis l'atlas
+    double color = 0;     // tables gamma / calibration
+    double delta = 0;     // seuil perceptuel + encodage de la trame
+    double serialBytes = 0;
+};
+
+static const char* filterName(SamplingFilter filter) {
+    return filter == SamplingFilter::Area ? "area" : "nearest";
+}
+
+static double elapsedNs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool runConfig(syntheticFrame& image, const BenchConfig& config, int frames, BenchTotals& totals) {
+    SamplingParams params;
+    params.ledX = config.ledX;
+    params.ledY = config.ledY;
+    params.keepPixels = config.keepPixels;
+    params.reduction = config.reduction;
+    params.filter = config.filter;
+
+    samplingEngine bufferedEngine;
+    samplingEngine fusedEngine;
+    samplingEngine atlasEngine;
+    colorPipeline colors;
+    changeDetector detector;
+    ledDeltaEncoder encoder;
+
+    std::vector<int> ledColors;
+    std::vector<int> referenceColors;
+    std::vector<uint16_t> precise;
+    std::vector<int> shown;
+    std::vector<bool> changed;
+
+    const SamplingLayout* layout = atlasEngine.prepare(image.width, image.height, params);
+    if (!layout) return false;
+    BorderAtlas atlas;
+    const bool useAtlas = atlas.build(*layout);
+    const uint32_t atlasPitch = ((atlas.width * 4 + 255) / 256) * 256;
+    std::vector<uint8_t> atlasPixels(useAtlas ? static_cast<size_t>(atlasPitch) * atlas.height : 0);
+
+    // Une image de chauffe (construction des géométries, threads du pool)
+    const FrameView warmup = image.view();
+    params.mode = SamplingMode::Buffered;
+    if (!bufferedEngine.sample(warmup, params, referenceColors)) return false;
+    params.mode = SamplingMode::Fused;
+    if (!fusedEngine.sample(warmup, params, ledColors)) return false;
+    if (ledColors != referenceColors) {
+        std::printf("  !! fused result differs from buffered reference\n");
+        return false;
+    }
+    if (useAtlas) {
+        // Même résultat attendu en lisant les bordures remappées dans l'atlas
+        atlas.copyRegions(warmup, atlasPixels.data(), atlasPitch);
+        if (!atlasEngine.sample(atlas.view(atlasPixels.data(), atlasPitch), params, ledColors)) return false;
+        if (ledColors != referenceColors) {
+            std::printf("  !! atlas result differs from buffered reference\n");
+            return false;
+        }
+    }
+
+    for (int f = 0; f < frames; ++f) {
+        image.advance(f);
+        const FrameView frame = image.view();
+
+        params.mode = SamplingMode::Buffered;
+        auto start = std::chrono::steady_clock::now();
+        bufferedEngine.sample(frame, params, referenceColors);
+        totals.buffered += elapsedNs(start);
+
+        params.mode = SamplingMode::Fused;
+        start = std::chrono::steady_clock::now();
+        fusedEngine.sample(frame, params, ledColors);
+        totals.fused += elapsedNs(start);
+
+        if (useAtlas) {
+            start = std::chrono::steady_clock::now();
+            atlas.copyRegions(frame, atlasPixels.data(), atlasPitch);
+            atlasEngine.sample(atlas.view(atlasPixels.data(), atlasPitch), params, ledColors);
+            totals.atlas += elapsedNs(start);
+        }
+
+        start = std::chrono::steady_clock::now();
+        colors.apply(ledColors.data(), static_cast<int>(ledColors.size()), precise);
+        totals.color += elapsedNs(start);
+
+        start = std::chrono::steady_clock::now();
+        const int total = static_cast<int>(ledColors.size());
+        size_t bytes = 0;
+        if (detector.update(precise.data(), total, shown, changed)) {
+            const std::vector<uint8_t>* frameBytes = encoder.encode(shown.data(), changed, total, 0);
+            bytes = frameBytes ? frameBytes->size() : 0;
+        }
+        totals.delta += elapsedNs(start);
+        totals.serialBytes += static_cast<double>(bytes);
+    }
+    return true;
+}
+
+// Zones à la limite des sommes sur 32 bits (MAX_ZONE_PIXELS) : image 8K blanche, une LED
+// par bord et une bande de la demi-hauteur, soit ~16,6 millions de pixels pour les zones
+// haut et bas. La moyenne doit rester exacte ; une bande plus épaisse doit être refusée.
+static bool checkZoneLimit() {
+    const uint32_t width = 7680;
+    const uint32_t height = 4320;
+    std::vector<uint8_t> white(static_cast<size_t>(width) * height * 4, 0xFF);
+    FrameView frame;
+    frame.data = white.data();
+    frame.rowPitch = width * 4;
+    frame.width = width;
+    frame.height = height;
+
+    SamplingParams params;
+    params.ledX = 1;
+    params.ledY = 1;
+    params.keepPixels = height / 2;
+    params.filter = SamplingFilter::Area;
+
+    samplingEngine engine;
+    std::vector<int> ledColors;
+    const SamplingLayout* layout = engine.prepare(width, height, params);
+    uint32_t largest = 0;
+    for (size_t i = 0; layout && i < layout->zonePixels.size(); ++i) {
+        largest = std::max(largest, layout->zonePixels[i]);
+    }
+    if (!layout || !engine.sample(frame, params, ledColors)) {
+        std::printf("  !! 8K zones of %u pixels rejected\n", largest);
+        return false;
+    }
+    for (size_t i = 0; i < ledColors.size(); ++i) {
+        if (layout->zonePixels[i] != 0 && ledColors[i] != 0xFFFFFF) {
+            std::printf("  !! zone %u of %u pixels: 0x%06X instead of 0xFFFFFF\n",
+                static_cast<unsigned>(i), layout->zonePixels[i], static_cast<unsigned>(ledColors[i]));
+            return false;
+        }
+    }
+
+    params.keepPixels = height;
+    if (engine.prepare(width, height, params)) {
+        std::printf("  !! zones above MAX_ZONE_PIXELS accepted\n");
+        return false;
+    }
+    std::printf("8K zone limit: %u pixels exact, larger zones rejected\n", largest);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    bool quick = false;
+    int frames = 0;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--quick") {
+            quick = true;
+        }
+        else if (arg == "--frames" && i + 1 < argc) {
+            frames = std::atoi(argv[++i]);
+        }
+        else {
+            std::printf("usage: %s [--quick] [--frames N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<BenchResolution> resolutions = {
+        { "1080p", 1920, 1080 },
+        { "1440p", 2560, 1440 },
+        { "4K", 3840, 2160 },
+        { "8K", 7680, 4320 },
+    };
+    if (quick) {
+        resolutions = { { "1080p", 1920, 1080 }, { "4K", 3840, 2160 } };
+    }
+
+    const SamplingFilter nearest = SamplingFilter::Nearest;
+    const SamplingFilter area = SamplingFilter::Area;
+    const BenchConfig configs[] = {
+        { 169, 90, 140, 1.0f, area }, // réglage du bureau
+        { 169, 90, 140, 2.0f, nearest },
+        { 169, 90, 140, 2.0f, area },
+        { 169, 90, 40, 1.0f, area },
+        { 169, 90, 35, 4.0f, nearest }, // même bande que 140 à 1.0
+        { 169, 90, 35, 4.0f, area },
+        { 60, 34, 140, 1.0f, area },
+        { 60, 34, 70, 4.0f, nearest },
+        { 60, 34, 70, 4.0f, area },
+        { 2, 2, 140, 1.0f, area }, // grandes zones : ~3840 x 140 pixels en 8K
+    };
+
+    std::printf("SIMD kernel: %s\n", sumBgraRowKernel().name);
+    if (!checkZoneLimit()) return 1;
+    std::printf("%-6s %4s %4s %5s %4s %-7s | %12s %12s %12s %10s %10s | %8s\n",
+        "res", "ledX", "ledY", "keep", "red", "filter",
+        "buffered ns", "fused ns", "atlas ns", "color ns", "delta ns", "bytes");
+
+    for (const BenchResolution& resolution : resolutions) {
+        syntheticFrame image(resolution.width, resolution.height);
+        const int frameCount = frames > 0 ? frames : (quick ? 20 : (resolution.width > 4000 ? 30 : 100));
+
+        for (const BenchConfig& config : configs) {
+            BenchTotals totals;
+            if (!runConfig(image, config, frameCount, totals)) {
+                std::printf("%-6s %4d %4d %5d %4.1f %-7s | invalid configuration\n",
+                    resolution.name, config.ledX, config.ledY, config.keepPixels, config.reduction, filterName(config.filter));
+                continue;
+            }
+            std::printf("%-6s %4d %4d %5d %4.1f %-7s | %12.0f %12.0f %12.0f %10.0f %10.0f | %8.0f\n",
+                resolution.name, config.ledX, config.ledY, config.keepPixels, config.reduction, filterName(config.filter),
+                totals.buffered / frameCount, totals.fused / frameCount, totals.atlas / frameCount,
+                totals.color / frameCount, totals.delta / frameCount, totals.serialBytes / frameCount);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,126 @@
+﻿#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Atlas des bordures : au lieu de relire toute l'image (33 Mo en 4K), seules les
+// régions réellement échantillonnées sont copiées côté GPU (CopySubresourceRegion)
+// dans une petite texture de staging. Les bandes haut et bas gardent toute la
+// largeur ; les bandes gauche et droite sont découpées en morceaux posés côte à
+// côte sous les premières pour que l'atlas reste aussi large que l'écran mais peu haut.
+//
+// Ce fichier est indépendant de l'OS : le placement des régions, les tables de
+// décalage de lignes et copyRegions() (référence CPU de la copie GPU) servent au
+// chemin DXGI comme aux tests hors machine de capture.
+
+// Région source [srcLeft, srcRight) x [srcTop, srcBottom) copiée en (atlasX, atlasY)
+struct AtlasStrip {
+    uint32_t srcLeft, srcTop, srcRight, srcBottom;
+    uint32_t atlasX, atlasY;
+};
+
+struct BorderAtlas {
+    LayoutKey key;
+    bool valid = false;
+
+    uint32_t width = 0;  // dimensions de l'atlas
+    uint32_t height = 0;
+    std::vector<AtlasStrip> strips;
+
+    // Décalages (en octets, depuis le début de l'atlas) de la ligne source y pour les
+    // colonnes de gauche et de droite : pixel (x, y) = atlas + offset[y] + x * 4
+    std::vector<int64_t> leftRowOffsets;
+    std::vector<int64_t> rightRowOffsets;
+    uint32_t offsetsPitch = 0;
+
+    // Calcule le placement pour une géométrie. Retourne false si l'atlas n'apporte
+    // rien (bandes qui se recouvrent) : il faut alors copier l'image complète.
+    bool build(const SamplingLayout& layout) {
+        valid = false;
+        key = layout.key;
+        strips.clear();
+        offsetsPitch = 0;
+        if (!layout.valid || layout.bandTop == 0 || layout.bandLeft == 0) return false;
+
+        const uint32_t frameWidth = layout.key.width;
+        const uint32_t frameHeight = layout.key.height;
+
+        // Lignes et colonnes sources couvertes par la bande (en pixels réels)
+        const uint32_t topRows = layout.srcRow[layout.bandTop - 1] + 1;
+        const uint32_t bottomStart = layout.srcRow[layout.bandBottom];
+        const uint32_t leftCols = layout.srcXOffset[layout.bandLeft - 1] / 4 + 1;
+        const uint32_t rightStart = layout.srcXOffset[layout.bandRight] / 4;
+        if (topRows >= bottomStart || leftCols >= rightStart) return false;
+
+        const uint32_t bottomRows = frameHeight - bottomStart;
+        const uint32_t middleRows = bottomStart - topRows;
+        const uint32_t rightCols = frameWidth - rightStart;
+        const uint32_t pieceWidth = leftCols + rightCols;
+
+        // Morceaux des bandes latérales posés côte à côte
+        const uint32_t pieces = frameWidth / pieceWidth;
+        const uint32_t rowsPerPiece = (middleRows + pieces - 1) / pieces;
+        const uint32_t middleY = topRows + bottomRows;
+
+        width = frameWidth;
+        height = middleY + rowsPerPiece;
+        if (height >= frameHeight) return false;
+
+        strips.push_back({ 0, 0, frameWidth, topRows, 0, 0 });
+        strips.push_back({ 0, bottomStart, frameWidth, frameHeight, 0, topRows });
+        for (uint32_t p = 0; p < pieces; ++p) {
+            const uint32_t rowStart = topRows + p * rowsPerPiece;
+            if (rowStart >= bottomStart) break;
+            const uint32_t rowEnd = rowStart + rowsPerPiece < bottomStart ? rowStart + rowsPerPiece : bottomStart;
+            strips.push_back({ 0, rowStart, leftCols, rowEnd, p * pieceWidth, middleY });
+            strips.push_back({ rightStart, rowStart, frameWidth, rowEnd, p * pieceWidth + leftCols, middleY });
+        }
+
+        valid = true;
+        return true;
+    }
+
+    // Recalcule les tables de décalage pour le RowPitch de l'atlas mappé
+    void buildRowOffsets(uint32_t rowPitch) {
+        if (!valid || offsetsPitch == rowPitch) return;
+        offsetsPitch = rowPitch;
+        leftRowOffsets.assign(key.height, 0);
+        rightRowOffsets.assign(key.height, 0);
+
+        for (const AtlasStrip& strip : strips) {
+            for (uint32_t y = strip.srcTop; y < strip.srcBottom; ++y) {
+                const int64_t rowOffset = static_cast<int64_t>(strip.atlasY + (y - strip.srcTop)) * rowPitch
+                    + (static_cast<int64_t>(strip.atlasX) - strip.srcLeft) * 4;
+                // Une bande pleine largeur sert aux deux côtés
+                if (strip.srcLeft == 0) leftRowOffsets[y] = rowOffset;
+                if (strip.srcRight == key.width) rightRowOffsets[y] = rowOffset;
+            }
+        }
+    }
+
+    // Vue sur l'atlas mappé, utilisable directement par samplingEngine::sample
+    FrameView view(const uint8_t* atlasData, uint32_t rowPitch) {
+        buildRowOffsets(rowPitch);
+
+        FrameView frame;
+        frame.data = atlasData;
+        frame.rowPitch = rowPitch;
+        frame.width = key.width;
+        frame.height = key.height;
+        frame.leftRowOffsets = leftRowOffsets.data();
+        frame.rightRowOffsets = rightRowOffsets.data();
+        return frame;
+    }
+
+    // Référence CPU de la copie GPU : remplit l'atlas à partir de l'image complète
+    void copyRegions(const FrameView& source, uint8_t* atlasData, uint32_t atlasPitch) const {
+        for (const AtlasStrip& strip : strips) {
+            const size_t bytes = static_cast<size_t>(strip.srcRight - strip.srcLeft) * 4;
+            for (uint32_t y = strip.srcTop; y < strip.srcBottom; ++y) {
+                const uint8_t* src = source.data + static_cast<size_t>(y) * source.rowPitch + static_cast<size_t>(strip.srcLeft) * 4;
+                uint8_t* dst = atlasData + static_cast<size_t>(strip.atlasY + (y - strip.srcTop)) * atlasPitch
+                    + static_cast<size_t>(strip.atlasX) * 4;
+                std::memcpy(dst, src, bytes);
+            }
+        }
+    }
+};
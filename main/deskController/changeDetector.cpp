@@ -0,0 +1,116 @@
+﻿#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+// Détection des LEDs à renvoyer. Comparer les couleurs bit à bit renvoyait presque
+// toute la bande à chaque image sur du contenu bruité (grain vidéo, tramage de
+// l'écran) : un écart n'est envoyé que s'il dépasse un seuil perceptuel, et les
+// petites dérives s'accumulent jusqu'à être envoyées quand même.
+//
+// Les couleurs arrivent en virgule fixe 8.8 (après la correction gamma) : le tramage
+// temporel optionnel récupère les dégradés sombres que l'arrondi à 8 bits écrase.
+// Indépendant de l'OS.
+
+struct ChangeDetectorConfig {
+    int threshold = 3;       // écart pondéré (échelle 0-255) à partir duquel une LED est renvoyée
+    int errorLimit = 24;     // écart cumulé sur les images non envoyées qui force l'envoi
+    bool dithering = false;  // tramage temporel des LEDs sombres
+    int ditherCeiling = 48;  // tramer seulement si la composante la plus forte est en dessous
+};
+
+class changeDetector {
+
+private:
+    std::vector<int> sent;          // couleur actuellement affichée par chaque LED
+    std::vector<uint16_t> error;    // écarts cumulés depuis le dernier envoi
+    std::vector<uint16_t> residual; // reste du tramage, 3 par LED (8 bits de fraction)
+
+    // Écart perçu entre deux couleurs 0x00RRGGBB : différences absolues pondérées
+    // comme la luminance (Rec. 709, poids sur 256)
+    static int weightedDelta(int a, int b) {
+        const int dr = std::abs(((a >> 16) & 0xFF) - ((b >> 16) & 0xFF));
+        const int dg = std::abs(((a >> 8) & 0xFF) - ((b >> 8) & 0xFF));
+        const int db = std::abs((a & 0xFF) - (b & 0xFF));
+        return (54 * dr + 183 * dg + 19 * db + 255) >> 8;
+    }
+
+    // Arrondi ou tramage d'une composante 8.8
+    static uint8_t quantize(uint16_t value, uint16_t& rest, bool dither) {
+        if (!dither) {
+            rest = 128;
+            const int rounded = (value + 128) >> 8;
+            return static_cast<uint8_t>(rounded > 255 ? 255 : rounded);
+        }
+        // Modulation sigma-delta : la moyenne des sorties successives vaut value / 256
+        const uint32_t acc = static_cast<uint32_t>(value) + rest;
+        uint32_t out = acc >> 8;
+        if (out > 255) out = 255;
+        rest = static_cast<uint16_t>(acc - (out << 8) > 255 ? 255 : acc - (out << 8));
+        return static_cast<uint8_t>(out);
+    }
+
+public:
+    ChangeDetectorConfig config;
+
+    // Oublie l'état de la bande : la prochaine image est envoyée en entier
+    void reset() {
+        sent.clear();
+    }
+
+    // precise : 3 composantes 8.8 (R, G, B) par LED. Écrit dans colors la couleur
+    // affichée après cette image (0x00RRGGBB) et marque dans changed les LEDs à envoyer.
+    // Retourne true si au moins une LED est marquée.
+    bool update(const uint16_t* precise, int total, std::vector<int>& colors, std::vector<bool>& changed) {
+        colors.resize(total);
+        changed.assign(total, false);
+
+        const bool first = sent.size() != static_cast<size_t>(total);
+        if (first) {
+            sent.assign(total, 0);
+            error.assign(total, 0);
+            residual.assign(static_cast<size_t>(total) * 3, 128);
+        }
+
+        bool anyChange = false;
+        for (int j = 0; j < total; ++j) {
+            const uint16_t* rgb = precise + static_cast<size_t>(j) * 3;
+            uint16_t* rest = residual.data() + static_cast<size_t>(j) * 3;
+
+            uint16_t brightest = rgb[0] > rgb[1] ? rgb[0] : rgb[1];
+            if (rgb[2] > brightest) brightest = rgb[2];
+            const bool dither = config.dithering && brightest < (config.ditherCeiling << 8);
+
+            const int color = (quantize(rgb[0], rest[0], dither) << 16)
+                | (quantize(rgb[1], rest[1], dither) << 8)
+                | quantize(rgb[2], rest[2], dither);
+
+            bool send = first;
+            if (!send && color == sent[j]) {
+                error[j] = 0;
+            }
+            else if (!send) {
+                if (dither) {
+                    // Le tramage n'a de sens que si chaque pas est affiché
+                    send = true;
+                }
+                else {
+                    const int delta = weightedDelta(color, sent[j]);
+                    const int accumulated = error[j] + delta;
+                    send = delta >= config.threshold || accumulated >= config.errorLimit;
+                    error[j] = static_cast<uint16_t>(accumulated > 0xFFFF ? 0xFFFF : accumulated);
+                }
+            }
+
+            if (send) {
+                changed[j] = true;
+                sent[j] = color;
+                error[j] = 0;
+                anyChange = true;
+            }
+            // colors reflète ce que la bande affiche : une image complète renvoie
+            // les LEDs non modifiées telles quelles
+            colors[j] = sent[j];
+        }
+        return anyChange;
+    }
+};
@@ -0,0 +1,94 @@
+﻿#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Correction des couleurs envoyées à la bande : gamma, balance des blancs, calibration
+// de la bande et plafond de luminosité sont combinés une fois pour toutes dans une
+// table de 256 entrées par composante. Par image il ne reste que des lectures de
+// table (plus de std::pow par LED).
+//
+// Les tables sont reconstruites à chaque changement de réglage puis publiées d'un
+// coup : apply() voit toujours un jeu de tables complet, même si un autre thread
+// change les réglages pendant la capture.
+
+struct ColorSettings {
+    float gamma = 0.3f;                            // plus gamma est grand, plus c'est sombre
+    float whiteBalance[3] = { 1.0f, 1.0f, 1.0f }; // gain par composante (R, G, B)
+    float stripGamma[3] = { 1.0f, 1.0f, 1.0f };   // calibration de la bande, par composante
+    float maxBrightness = 1.0f;                    // plafond de luminosité (0-1)
+
+    bool operator==(const ColorSettings& other) const {
+        for (int c = 0; c < 3; ++c) {
+            if (whiteBalance[c] != other.whiteBalance[c] || stripGamma[c] != other.stripGamma[c]) return false;
+        }
+        return gamma == other.gamma && maxBrightness == other.maxBrightness;
+    }
+};
+
+struct ColorTables {
+    ColorSettings settings;
+    uint16_t lut[3][256]; // entrée 8 bits -> sortie en virgule fixe 8.8 (0 - 255 * 256)
+
+    void build(const ColorSettings& newSettings) {
+        settings = newSettings;
+        const float invGamma = settings.gamma > 0.0f ? 1.0f / settings.gamma : 1.0f;
+        const float cap = settings.maxBrightness < 0.0f ? 0.0f : (settings.maxBrightness > 1.0f ? 1.0f : settings.maxBrightness);
+
+        for (int c = 0; c < 3; ++c) {
+            for (int i = 0; i < 256; ++i) {
+                float value = std::pow(i / 255.0f, invGamma);
+                value *= settings.whiteBalance[c];
+                if (value > 1.0f) value = 1.0f;
+                if (value < 0.0f) value = 0.0f;
+                value = std::pow(value, settings.stripGamma[c]);
+                value *= cap;
+                lut[c][i] = static_cast<uint16_t>(value * 65280.0f + 0.5f);
+            }
+        }
+    }
+};
+
+class colorPipeline {
+
+private:
+    std::shared_ptr<const ColorTables> tables;
+
+public:
+    colorPipeline(const ColorSettings& settings = ColorSettings()) {
+        configure(settings);
+    }
+
+    // Reconstruit les tables si les réglages ont changé et les publie atomiquement
+    void configure(const ColorSettings& settings) {
+        std::shared_ptr<const ColorTables> current = std::atomic_load(&tables);
+        if (current && current->settings == settings) return;
+
+        std::shared_ptr<ColorTables> next = std::make_shared<ColorTables>();
+        next->build(settings);
+        std::atomic_store(&tables, std::shared_ptr<const ColorTables>(next));
+    }
+
+    ColorSettings settings() const {
+        return std::atomic_load(&tables)->settings;
+    }
+
+    // pixels (0x00RRGGBB) -> 3 composantes 8.8 par LED dans precise
+    void apply(const int* pixels, int total, std::vector<uint16_t>& precise) const {
+        const std::shared_ptr<const ColorTables> current = std::atomic_load(&tables);
+        const uint16_t* lutR = current->lut[0];
+        const uint16_t* lutG = current->lut[1];
+        const uint16_t* lutB = current->lut[2];
+
+        precise.resize(static_cast<size_t>(total) * 3);
+        uint16_t* out = precise.data();
+        for (int i = 0; i < total; ++i) {
+            const uint32_t raw = static_cast<uint32_t>(pixels[i]);
+            out[0] = lutR[(raw >> 16) & 0xFF];
+            out[1] = lutG[(raw >> 8) & 0xFF];
+            out[2] = lutB[raw & 0xFF];
+            out += 3;
+        }
+    }
+};
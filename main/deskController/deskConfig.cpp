@@ -0,0 +1,439 @@
+﻿#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#endif
+
+// Réglages du bureau dans un fichier texte (deskController.cfg à côté de l'exécutable)
+// plutôt que dans le code : écran piloté et son mode, disposition des LEDs, position de
+// la bande et couleurs. Plusieurs profils nommés, un seul actif :
+//
+//   profile=bureau
+//
+//   [bureau]
+//   output=\\.\DISPLAY3          ; sortie allumée / éteinte par les boutons
+//   mode=3840x2160@120           ; appliqué à l'allumage
+//   position=633,-3760
+//   scale=150
+//   screen=2                     ; numéro de la sortie capturée (ordre DXGI)
+//   leds=169x90                  ; LEDs en haut / bas, à gauche / droite
+//   keepPixels=140
+//   reduction=1
+//   filter=area                  ; area (moyenne exacte) ou nearest (un pixel par pixel réduit)
+//   offset=460                   ; première LED logique sur la bande physique
+//   reversed=0                   ; bande posée dans l'autre sens
+//   gamma=0.3
+//   whiteBalance=1,1,1
+//   stripGamma=1,1,1
+//   maxBrightness=1
+//   maxFps=60
+//
+// Une clé absente garde sa valeur par défaut (celles ci-dessus). Le fichier est relu dès
+// qu'il change : un fichier invalide est signalé et l'ancien réglage reste en place.
+//
+// Plusieurs écrans sur la même bande : une section [profil.screen] par écran capturé
+// (clés screen, leds, keepPixels, reduction, filter), numérotées 0, 1... dans l'ordre du
+// fichier, et les segments de la bande dans l'ordre physique (voir stripMapping.cpp) :
+//
+//   [bureau]
+//   segment=1,248,90,0           ; écran, première LED, nombre de LEDs, sens inversé
+//   segment=0,0,518,0
+//
+//   [bureau.screen]
+//   screen=2
+//   leds=169x90
+//
+//   [bureau.screen]
+//   screen=1
+//   leds=124x90
+//
+// Les clés screen, leds... du profil décrivent alors l'écran seul s'il n'y a aucune
+// section [profil.screen] ; sans segment, chaque écran fait tout son tour, offset et
+// reversed s'appliquent à la bande entière.
+
+struct DeskProfile {
+    std::string name = "bureau";
+    MonitorMode monitor;
+    ScreenZones zones;
+    int stripOffset = 460;
+    bool stripReversed = false;
+    ColorSettings color;
+    int maxFps = 60;
+    std::vector<ScreenZones> screens;   // sections [profil.screen] ; vide : zones seul
+    std::vector<StripSegment> segments; // lignes segment= ; vide : tour complet de chaque écran
+
+    DeskProfile() {
+        zones.screenId = 2;
+        zones.ledX = 169;
+        zones.ledY = 90;
+        zones.filter = SamplingFilter::Area; // le bureau lisse ; les points d'entrée exportés restent en Nearest
+    }
+
+    // Écrans capturés et ordre de la bande
+    StripMapping mapping() const {
+        StripMapping result;
+        result.screens = screens.empty() ? std::vector<ScreenZones>(1, zones) : screens;
+        result.segments = segments;
+        if (result.segments.empty()) {
+            for (size_t i = 0; i < result.screens.size(); ++i) {
+                StripSegment segment;
+                segment.screen = static_cast<int>(i);
+                segment.count = ledCount(result.screens[i].ledX, result.screens[i].ledY);
+                segment.reversed = stripReversed;
+                result.segments.push_back(segment);
+            }
+        }
+        return result;
+    }
+
+    // Message d'erreur, vide si le profil est utilisable
+    std::string validate() const {
+        if (monitor.deviceName.empty()) return "output vide";
+        if (monitor.width <= 0 || monitor.height <= 0 || monitor.frequency <= 0) return "mode invalide";
+        if (monitor.scalePercent < 100 || monitor.scalePercent > 500) return "scale hors de 100-500";
+        if (!mapping().valid()) return "disposition des LEDs invalide (screen, leds, reduction, segment)";
+        for (const ScreenZones& screen : mapping().screens) {
+            if (screen.keepPixels <= 0) return "keepPixels doit être positif";
+        }
+        if (stripOffset < 0) return "offset négatif";
+        if (color.gamma <= 0.0f) return "gamma doit être positif";
+        if (color.maxBrightness < 0.0f || color.maxBrightness > 1.0f) return "maxBrightness hors de 0-1";
+        for (int c = 0; c < 3; ++c) {
+            if (color.whiteBalance[c] < 0.0f || color.stripGamma[c] <= 0.0f) return "whiteBalance / stripGamma invalide";
+        }
+        if (maxFps <= 0 || maxFps > 1000) return "maxFps hors de 1-1000";
+        return std::string();
+    }
+};
+
+struct DeskConfig {
+    uint64_t version = 0;              // augmente à chaque rechargement réussi
+    std::vector<DeskProfile> profiles;
+    std::string activeProfile;         // vide : le premier profil
+
+    const DeskProfile* active() const {
+        if (activeProfile.empty()) return profiles.empty() ? nullptr : &profiles[0];
+        for (const DeskProfile& profile : profiles) {
+            if (profile.name == activeProfile) return &profile;
+        }
+        return nullptr;
+    }
+};
+
+// Sans fichier : le réglage d'origine
+inline DeskConfig defaultDeskConfig() {
+    DeskConfig config;
+    config.profiles.push_back(DeskProfile());
+    return config;
+}
+
+inline bool parseConfigInt(const std::string& text, int& value) {
+    char* end = nullptr;
+    const long parsed = std::strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0') return false;
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+inline bool parseConfigFloat(const std::string& text, float& value) {
+    char* end = nullptr;
+    const float parsed = std::strtof(text.c_str(), &end);
+    if (text.empty() || *end != '\0') return false;
+    value = parsed;
+    return true;
+}
+
+// "a<separator>b" ; "3840x2160" ou "633,-3760"
+inline bool parseConfigPair(const std::string& text, char separator, int& first, int& second) {
+    const size_t split = text.find(separator);
+    return split != std::string::npos
+        && parseConfigInt(text.substr(0, split), first) && parseConfigInt(text.substr(split + 1), second);
+}
+
+// "r,g,b"
+inline bool parseConfigTriple(const std::string& text, float values[3]) {
+    std::istringstream parts(text);
+    std::string part;
+    for (int c = 0; c < 3; ++c) {
+        if (!std::getline(parts, part, ',')) return false;
+        part.erase(0, part.find_first_not_of(" \t"));
+        part.erase(part.find_last_not_of(" \t") + 1);
+        if (!parseConfigFloat(part, values[c])) return false;
+    }
+    return !std::getline(parts, part, ',');
+}
+
+// "écran,première LED,nombre,inversé"
+inline bool parseConfigSegment(const std::string& text, StripSegment& segment) {
+    std::istringstream parts(text);
+    std::string part[4];
+    for (int i = 0; i < 4; ++i) {
+        if (!std::getline(parts, part[i], ',')) return false;
+        part[i].erase(0, part[i].find_first_not_of(" \t"));
+        part[i].erase(part[i].find_last_not_of(" \t") + 1);
+    }
+    std::string extra;
+    if (std::getline(parts, extra, ',') || (part[3] != "0" && part[3] != "1")) return false;
+    segment.reversed = part[3] == "1";
+    return parseConfigInt(part[0], segment.screen) && parseConfigInt(part[1], segment.firstLed)
+        && parseConfigInt(part[2], segment.count);
+}
+
+// Clés d'échantillonnage d'un écran, dans [profil] ou [profil.screen]
+inline bool applyScreenKey(ScreenZones& zones, const std::string& key, const std::string& value) {
+    if (key == "screen") return parseConfigInt(value, zones.screenId);
+    if (key == "leds") return parseConfigPair(value, 'x', zones.ledX, zones.ledY);
+    if (key == "keepPixels") return parseConfigInt(value, zones.keepPixels);
+    if (key == "reduction") return parseConfigFloat(value, zones.reduction);
+    if (key == "filter") {
+        if (value != "area" && value != "nearest") return false;
+        zones.filter = value == "area" ? SamplingFilter::Area : SamplingFilter::Nearest;
+        return true;
+    }
+    return false;
+}
+
+inline bool applyProfileKey(DeskProfile& profile, const std::string& key, const std::string& value) {
+    if (key == "output") { profile.monitor.deviceName = value; return !value.empty(); }
+    if (key == "mode") {
+        const size_t at = value.find('@');
+        if (at == std::string::npos) return parseConfigPair(value, 'x', profile.monitor.width, profile.monitor.height);
+        return parseConfigPair(value.substr(0, at), 'x', profile.monitor.width, profile.monitor.height)
+            && parseConfigInt(value.substr(at + 1), profile.monitor.frequency);
+    }
+    if (key == "position") return parseConfigPair(value, ',', profile.monitor.positionX, profile.monitor.positionY);
+    if (key == "scale") return parseConfigInt(value, profile.monitor.scalePercent);
+    if (applyScreenKey(profile.zones, key, value)) return true;
+    if (key == "segment") {
+        StripSegment segment;
+        if (!parseConfigSegment(value, segment)) return false;
+        profile.segments.push_back(segment);
+        return true;
+    }
+    if (key == "offset") return parseConfigInt(value, profile.stripOffset);
+    if (key == "reversed") {
+        if (value != "0" && value != "1") return false;
+        profile.stripReversed = value == "1";
+        return true;
+    }
+    if (key == "gamma") return parseConfigFloat(value, profile.color.gamma);
+    if (key == "whiteBalance") return parseConfigTriple(value, profile.color.whiteBalance);
+    if (key == "stripGamma") return parseConfigTriple(value, profile.color.stripGamma);
+    if (key == "maxBrightness") return parseConfigFloat(value, profile.color.maxBrightness);
+    if (key == "maxFps") return parseConfigInt(value, profile.maxFps);
+    return false;
+}
+
+// Lit le texte du fichier de configuration. Retourne false avec error (ligne comprise)
+// si une ligne, un profil ou le profil actif est invalide ; config n'est alors pas
+// modifié. Fonction pure.
+inline bool parseDeskConfig(const std::string& text, DeskConfig& config, std::string& error) {
+    DeskConfig parsed;
+    DeskProfile* current = nullptr;
+    ScreenZones* currentScreen = nullptr; // section [profil.screen] en cours
+    std::istringstream lines(text);
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(lines, line)) {
+        lineNumber++;
+        if (lineNumber == 1 && line.compare(0, 3, "\xEF\xBB\xBF") == 0) line.erase(0, 3);
+        // Commentaire : ';' ou '#' en début de ligne ou après un blanc (garde \\.\DISPLAY3)
+        for (size_t i = 0; i < line.size(); ++i) {
+            if ((line[i] == ';' || line[i] == '#') && (i == 0 || line[i - 1] == ' ' || line[i - 1] == '\t')) {
+                line.erase(i);
+                break;
+            }
+        }
+        line.erase(0, line.find_first_not_of(" \t"));
+        line.erase(line.find_last_not_of(" \t\r\n") + 1);
+        if (line.empty()) continue;
+
+        const std::string where = "ligne " + std::to_string(lineNumber) + " : ";
+        if (line.front() == '[') {
+            if (line.back() != ']' || line.size() < 3) {
+                error = where + "section invalide";
+                return false;
+            }
+            const std::string name = line.substr(1, line.size() - 2);
+            const std::string screenSuffix = ".screen";
+            if (name.size() > screenSuffix.size()
+                && name.compare(name.size() - screenSuffix.size(), screenSuffix.size(), screenSuffix) == 0) {
+                const std::string owner = name.substr(0, name.size() - screenSuffix.size());
+                current = nullptr;
+                for (DeskProfile& profile : parsed.profiles) {
+                    if (profile.name == owner) current = &profile;
+                }
+                if (!current) {
+                    error = where + "profil " + owner + " à déclarer avant ses écrans";
+                    return false;
+                }
+                // Même filtre par défaut que l'écran du profil ; screen et leds sont à donner
+                ScreenZones screen;
+                screen.filter = DeskProfile().zones.filter;
+                current->screens.push_back(screen);
+                currentScreen = &current->screens.back();
+                continue;
+            }
+            for (const DeskProfile& profile : parsed.profiles) {
+                if (profile.name == name) {
+                    error = where + "profil " + name + " en double";
+                    return false;
+                }
+            }
+            parsed.profiles.push_back(DeskProfile());
+            current = &parsed.profiles.back();
+            current->name = name;
+            currentScreen = nullptr;
+            continue;
+        }
+
+        const size_t separator = line.find('=');
+        if (separator == std::string::npos) {
+            error = where + "clé=valeur attendu";
+            return false;
+        }
+        std::string key = line.substr(0, separator);
+        key.erase(key.find_last_not_of(" \t") + 1);
+        std::string value = line.substr(separator + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+
+        if (!current) {
+            if (key != "profile") {
+                error = where + "clé " + key + " hors d'un profil";
+                return false;
+            }
+            parsed.activeProfile = value;
+            continue;
+        }
+        if (currentScreen ? !applyScreenKey(*currentScreen, key, value) : !applyProfileKey(*current, key, value)) {
+            error = where + "clé inconnue ou valeur invalide : " + key;
+            return false;
+        }
+    }
+
+    if (parsed.profiles.empty()) {
+        error = "aucun profil";
+        return false;
+    }
+    for (const DeskProfile& profile : parsed.profiles) {
+        const std::string problem = profile.validate();
+        if (!problem.empty()) {
+            error = "profil " + profile.name + " : " + problem;
+            return false;
+        }
+    }
+    if (!parsed.active()) {
+        error = "profil actif " + parsed.activeProfile + " introuvable";
+        return false;
+    }
+    parsed.version = config.version;
+    config = parsed;
+    return true;
+}
+
+#ifdef _WIN32
+
+// Chemin de file dans le dossier de l'exécutable, quel que soit le dossier courant
+inline std::string besideExecutable(const std::string& file) {
+    char modulePath[MAX_PATH] = {};
+    const DWORD length = GetModuleFileNameA(NULL, modulePath, MAX_PATH);
+    if (length == 0 || length >= MAX_PATH) return file;
+    std::string directory(modulePath, length);
+    const size_t slash = directory.find_last_of("\\/");
+    return slash == std::string::npos ? file : directory.substr(0, slash + 1) + file;
+}
+
+// Fichier de configuration surveillé : un thread dort sur FindFirstChangeNotification
+// (dossier du fichier) et republie la configuration quand son contenu change. current()
+// ne prend aucun verrou ; la boucle principale compare les versions à chaque image.
+class deskConfigWatcher {
+
+private:
+    std::string path;
+    std::string lastText;
+    std::shared_ptr<const DeskConfig> config;
+    HANDLE stopEvent;
+    std::thread watcherThread;
+
+    static std::string directoryOf(const std::string& file) {
+        const size_t slash = file.find_last_of("\\/");
+        return slash == std::string::npos ? std::string(".") : file.substr(0, slash);
+    }
+
+    // Relit le fichier ; retourne true si une nouvelle configuration a été publiée
+    bool reload() {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return false;
+        std::ostringstream content;
+        content << in.rdbuf();
+        const std::string text = content.str();
+        if (text == lastText) return false;
+        lastText = text;
+
+        const std::shared_ptr<const DeskConfig> previous = std::atomic_load(&config);
+        DeskConfig next;
+        std::string error;
+        if (!parseDeskConfig(text, next, error)) {
+            std::cerr << path << " ignoré, " << error << std::endl;
+            return false;
+        }
+        next.version = previous ? previous->version + 1 : 1;
+        std::atomic_store(&config, std::shared_ptr<const DeskConfig>(std::make_shared<DeskConfig>(next)));
+        std::cout << path << " chargé, profil " << next.active()->name << std::endl;
+        return true;
+    }
+
+    void run() {
+        HANDLE change = FindFirstChangeNotificationA(directoryOf(path).c_str(), FALSE,
+            FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+        if (change == INVALID_HANDLE_VALUE) {
+            std::cerr << "Configuration : pas de suivi des modifications de " << path << std::endl;
+            return;
+        }
+        const HANDLE events[2] = { change, stopEvent };
+        while (WaitForMultipleObjects(2, events, FALSE, INFINITE) == WAIT_OBJECT_0) {
+            // Les éditeurs écrivent en plusieurs fois : laisser le fichier se stabiliser
+            if (WaitForSingleObject(stopEvent, 100) == WAIT_OBJECT_0) break;
+            reload();
+            if (!FindNextChangeNotification(change)) break;
+        }
+        FindCloseChangeNotification(change);
+    }
+
+public:
+    explicit deskConfigWatcher(const std::string& file) : path(file) {
+        if (!reload()) {
+            std::cout << path << " absent ou invalide, réglages par défaut" << std::endl;
+            std::atomic_store(&config, std::shared_ptr<const DeskConfig>(std::make_shared<DeskConfig>(defaultDeskConfig())));
+        }
+        stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        if (stopEvent) {
+            watcherThread = std::thread(&deskConfigWatcher::run, this);
+        }
+    }
+
+    ~deskConfigWatcher() {
+        if (stopEvent) SetEvent(stopEvent);
+        if (watcherThread.joinable()) {
+            watcherThread.join();
+        }
+        if (stopEvent) CloseHandle(stopEvent);
+    }
+
+    deskConfigWatcher(const deskConfigWatcher&) = delete;
+    deskConfigWatcher& operator=(const deskConfigWatcher&) = delete;
+
+    std::shared_ptr<const DeskConfig> current() const {
+        return std::atomic_load(&config);
+    }
+};
+
+#endif
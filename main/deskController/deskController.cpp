@@ -2,103 +2,342 @@
 #include <iostream>
 #include <fstream>
 #include <thread> 
+#include <mutex>
 #include <wrl/client.h>
 
-#include <d3d11.h>
+#include <d3d11_4.h>
 #include <dxgi1_2.h>
 #include <vector>
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "dxgi.lib")
 
+#define USE_PARALLEL 1
+#define USE_FRAMED_PROTOCOL 1
+#define USE_FRAMED_MCU_PROTOCOL 1 // commandes du microcontrôleur en trames (voir mcuChannel.cpp)
+//#define LOG_STAGE_STATS 1 // latences par étape (p50/p95/p99/max) affichées chaque seconde
+
+#include "serialTransport.cpp"
+#include "ledProtocol.cpp"
+#include "mcuChannel.cpp"
 #include "serialHelper.cpp"
+#include "serialDiscovery.cpp"
+#include "displayTopology.cpp"
 #include "screenController.cpp"
 
+#include "samplingEngine.cpp"
+#include "borderAtlas.cpp"
+#include "stripMapping.cpp"
+#include "changeDetector.cpp"
+#include "colorPipeline.cpp"
+#include "stageStats.cpp"
+#include "ledWriter.cpp"
+#include "framePacer.cpp"
+#include "deskConfig.cpp"
+
 using namespace Microsoft::WRL;
 
 HANDLE serialPort_led = INVALID_HANDLE_VALUE;
 HANDLE serialPort_mcu = INVALID_HANDLE_VALUE;
 
-std::vector<int> previousLedColors;
+extern "C" {
 
-#define USE_PARALLEL 1
+    // Nombre de textures de staging en anneau : la copie GPU de l'image N+1 part pendant
+    // que le CPU lit l'image N. Au plus une image reste en attente entre deux appels.
+    const int CAPTURE_RING_SIZE = 2;
+
+    // Une copie GPU en cours ou terminée, pas encore lue par le CPU
+    struct CaptureSlot {
+        ComPtr<ID3D11Texture2D> stagingTexture; // image complète, créée au premier besoin
+        ComPtr<ID3D11Texture2D> atlasTexture;   // staging réduit aux bordures (voir borderAtlas.cpp)
+        bool pending = false;
+        bool useAtlas = false;
+        bool allDirty = true;                   // sinon seules les zones touchées par rects
+        std::vector<FrameRect> rects;
+        LayoutKey key;
+    };
 
-extern "C" {
+    // Périphérique D3D11 d'une carte graphique, partagé par toutes ses sorties : plusieurs
+    // écrans sur la même carte n'ont plus chacun leur device, leurs copies passent par la
+    // même file GPU
+    struct AdapterDevice {
+        LUID luid;
+        ComPtr<ID3D11Device> device;
+        ComPtr<ID3D11DeviceContext> context;
+    };
+
+    // Reprise après une perte de la duplication : le périphérique est gardé et seule la
+    // sortie est redupliquée, en réessayant avec un délai croissant. Pendant ce temps les
+    // LEDs restent sur la dernière image, puis s'éteignent en fondu si la reprise traîne.
+    const int RECOVERY_BACKOFF_MIN_MS = 4;
+    const int RECOVERY_BACKOFF_MAX_MS = 250;
+    const int RECOVERY_FULL_REINIT_AFTER = 6; // échecs de reduplication avant de tout rouvrir
+    const int RECOVERY_HOLD_MS = 300;         // dernière image tenue telle quelle
+    const int RECOVERY_FADE_MS = 1000;        // puis fondu jusqu'au noir
+
+    enum class CaptureState {
+        Closed,  // pas de sortie ouverte : recherche de la sortie et du périphérique de la carte
+        Running,
+        Lost     // accès perdu (changement de mode, UAC, plein écran) : sortie à redupliquer
+    };
 
     struct ScreenDevice {
-        ComPtr<ID3D11Device> device;
+        ComPtr<ID3D11Device> device;          // celui de la carte (voir AdapterDevice)
         ComPtr<ID3D11DeviceContext> context;
+        ComPtr<IDXGIOutput1> output;          // gardée pour redupliquer sans tout rouvrir
         ComPtr<IDXGIOutputDuplication> duplication;
-        ComPtr<ID3D11Texture2D> stagingTexture;
-        std::vector<int> pixelBuffer;
+        CaptureSlot slots[CAPTURE_RING_SIZE];
+        int nextSlot = 0;                     // prochaine copie ; les copies en attente sont lues dans l'ordre
+        BorderAtlas atlas;
+        bool useBorderAtlas = true;
+        bool useDirtyRects = true;            // ne recalcule que les zones touchées par les rectangles modifiés
+        std::vector<uint8_t> metadataBuffer;  // move/dirty rects DXGI de l'image courante
+        std::vector<FrameRect> frameRects;
+        samplingEngine engine;
+        std::vector<int> ledBuffers[2]; // double buffer des couleurs, réutilisé d'une image à l'autre
+        int frontBuffer = 0;            // dernier buffer complet, exposé par getScreenPixelsShared
+        int frontLedX = 0;              // disposition des LEDs du buffer avant
+        int frontLedY = 0;
         UINT width = 0;
         UINT height = 0;
-        UINT reducedWidth = 0;
-        UINT reducedHeight = 0;
-        bool initialized = false;
+        UINT acquireTimeoutMs = 10;     // attente maximale d'une nouvelle image (voir framePacer)
+        bool presented = false;         // la dernière capture contenait une nouvelle image du bureau
+        std::string outputName;         // \\.\DISPLAYn, pour suivre les changements de topologie
+        CaptureState state = CaptureState::Closed;
+        int failedAttempts = 0;         // tentatives de reprise échouées d'affilée
+        std::chrono::steady_clock::time_point nextAttempt; // pas de tentative avant
+        std::chrono::steady_clock::time_point lostSince;
+        std::vector<int> heldColors;    // dernière image valide, rejouée en fondu pendant la reprise
+        int heldLedX = 0;               // disposition de heldColors
+        int heldLedY = 0;
     };
 
     static std::vector<ScreenDevice> g_screens;
+    static std::vector<AdapterDevice> g_adapters;
+    static std::mutex g_adapterMutex;               // les écrans s'initialisent depuis les threads de capture
+    static std::unique_ptr<workerPool> g_capturePool; // un participant par écran capturé en parallèle
+
+    // Abandonne les copies en attente et les textures (nouveau périphérique ou mode d'écran)
+    static void resetCaptureSlots(ScreenDevice& screen) {
+        for (CaptureSlot& slot : screen.slots) {
+            slot = CaptureSlot();
+        }
+        screen.nextSlot = 0;
+    }
 
-    bool initializeScreen(int screenId, float reduction) {
-        if (screenId < 0 || reduction <= 0) return false;
+    // Le périphérique de la carte ne sert plus (retiré ou réinitialisé par le pilote)
+    static void forgetAdapterDevice(ID3D11Device* device) {
+        std::lock_guard<std::mutex> lock(g_adapterMutex);
+        for (auto it = g_adapters.begin(); it != g_adapters.end(); ++it) {
+            if (it->device.Get() == device) {
+                g_adapters.erase(it);
+                return;
+            }
+        }
+    }
 
-        if (screenId >= g_screens.size()) {
-            g_screens.resize(screenId + 1);
+    // Arrête la duplication et garde la dernière image pour la reprise. deviceLost : le
+    // périphérique est inutilisable, tout sera rouvert ; sinon seule la sortie est redupliquée.
+    static void suspendCapture(ScreenDevice& screen, bool deviceLost) {
+        if (screen.state == CaptureState::Running) {
+            screen.heldColors = screen.ledBuffers[screen.frontBuffer];
+            screen.heldLedX = screen.frontLedX;
+            screen.heldLedY = screen.frontLedY;
+            screen.lostSince = std::chrono::steady_clock::now();
+            screen.nextAttempt = screen.lostSince;
+            screen.failedAttempts = 0;
+        }
+        screen.duplication.Reset();
+        resetCaptureSlots(screen);
+        screen.state = CaptureState::Lost;
+        if (deviceLost) {
+            forgetAdapterDevice(screen.device.Get());
+            screen.device.Reset();
+            screen.context.Reset();
+            screen.output.Reset();
+            screen.state = CaptureState::Closed;
         }
+    }
 
-        if (g_screens[screenId].initialized) return true;
+    // Dernière image valide, atténuée selon la durée de la reprise ; nullptr sans image ou
+    // si elle a été échantillonnée pour une autre disposition que ledX x ledY
+    static std::vector<int>* heldColorsFaded(ScreenDevice& screen, int ledX, int ledY) {
+        if (screen.heldColors.empty() || screen.heldLedX != ledX || screen.heldLedY != ledY) return nullptr;
+
+        const long long elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - screen.lostSince).count();
+        int level = 256;
+        if (elapsedMs > RECOVERY_HOLD_MS) {
+            level = static_cast<int>(256 - (elapsedMs - RECOVERY_HOLD_MS) * 256 / RECOVERY_FADE_MS);
+            if (level < 0) level = 0;
+        }
 
-        HRESULT hr;
-        ScreenDevice& screen = g_screens[screenId];
+        std::vector<int>& ledColors = screen.ledBuffers[1 - screen.frontBuffer];
+        ledColors.resize(screen.heldColors.size());
+        for (size_t j = 0; j < ledColors.size(); ++j) {
+            const int color = screen.heldColors[j];
+            const int r = (((color >> 16) & 0xFF) * level) >> 8;
+            const int g = (((color >> 8) & 0xFF) * level) >> 8;
+            const int b = ((color & 0xFF) * level) >> 8;
+            ledColors[j] = (r << 16) | (g << 8) | b;
+        }
+        screen.frontBuffer = 1 - screen.frontBuffer;
+        screen.frontLedX = ledX;
+        screen.frontLedY = ledY;
+        return &ledColors;
+    }
 
-        D3D_FEATURE_LEVEL featureLevel;
-        hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, 0,
-            nullptr, 0, D3D11_SDK_VERSION, &screen.device, &featureLevel, &screen.context);
-        if (FAILED(hr)) return false;
+    // Réinitialise d'avance les écrans dont la sortie a changé de mode, de position ou a
+    // disparu, sans attendre que DXGI signale la perte d'accès. À appeler entre deux captures.
+    static void syncScreensWithTopology(const TopologySnapshot& topology) {
+        for (ScreenDevice& screen : g_screens) {
+            if (screen.state != CaptureState::Running || screen.width == 0) continue;
+            const OutputState* output = topology.find(screen.outputName);
+            if (!output || !output->active || output->width != static_cast<int>(screen.width)
+                || output->height != static_cast<int>(screen.height)) {
+                std::cout << "Topologie modifiée, réinitialisation de " << screen.outputName << std::endl;
+                suspendCapture(screen, false);
+            }
+        }
+    }
 
-        ComPtr<IDXGIDevice> dxgiDevice;
-        hr = screen.device.As(&dxgiDevice);
-        if (FAILED(hr)) return false;
+    // Sortie numéro screenId en comptant les sorties de toutes les cartes dans l'ordre DXGI.
+    // Les sorties de la première carte gardent donc leur numéro d'origine.
+    static bool findOutput(int screenId, ComPtr<IDXGIAdapter1>& adapter, ComPtr<IDXGIOutput>& output) {
+        ComPtr<IDXGIFactory1> factory;
+        if (FAILED(CreateDXGIFactory1(IID_PPV_ARGS(&factory)))) return false;
+
+        int index = 0;
+        for (UINT a = 0; factory->EnumAdapters1(a, &adapter) != DXGI_ERROR_NOT_FOUND; ++a) {
+            for (UINT o = 0; adapter->EnumOutputs(o, &output) != DXGI_ERROR_NOT_FOUND; ++o) {
+                if (index++ == screenId) return true;
+            }
+        }
+        return false;
+    }
+
+    // Périphérique partagé de la carte, créé au premier écran qui en a besoin
+    static bool acquireAdapterDevice(IDXGIAdapter1* adapter, ComPtr<ID3D11Device>& device, ComPtr<ID3D11DeviceContext>& context) {
+        DXGI_ADAPTER_DESC1 adapterDesc;
+        if (FAILED(adapter->GetDesc1(&adapterDesc))) return false;
+
+        std::lock_guard<std::mutex> lock(g_adapterMutex);
+        for (const AdapterDevice& shared : g_adapters) {
+            if (shared.luid.LowPart == adapterDesc.AdapterLuid.LowPart && shared.luid.HighPart == adapterDesc.AdapterLuid.HighPart) {
+                device = shared.device;
+                context = shared.context;
+                return true;
+            }
+        }
 
-        ComPtr<IDXGIAdapter> dxgiAdapter;
-        hr = dxgiDevice->GetAdapter(&dxgiAdapter);
+        // Adaptateur explicite : le type de pilote doit être UNKNOWN
+        D3D_FEATURE_LEVEL featureLevel;
+        HRESULT hr = D3D11CreateDevice(adapter, D3D_DRIVER_TYPE_UNKNOWN, nullptr, 0,
+            nullptr, 0, D3D11_SDK_VERSION, &device, &featureLevel, &context);
         if (FAILED(hr)) return false;
 
+        // Le contexte immédiat sera utilisé par plusieurs threads de capture : D3D sérialise
+        // alors ses appels. Sans cette protection (avant Windows 10), l'écran garde un
+        // périphérique à lui, comme avant.
+        ComPtr<ID3D11Multithread> multithread;
+        if (SUCCEEDED(context.As(&multithread))) {
+            multithread->SetMultithreadProtected(TRUE);
+            AdapterDevice shared;
+            shared.luid = adapterDesc.AdapterLuid;
+            shared.device = device;
+            shared.context = context;
+            g_adapters.push_back(shared);
+        }
+        return true;
+    }
+
+    // Ouvre la sortie screenId : carte, périphérique partagé, nom de la sortie
+    static bool openOutput(int screenId, ScreenDevice& screen) {
+        ComPtr<IDXGIAdapter1> dxgiAdapter;
         ComPtr<IDXGIOutput> dxgiOutput;
-        hr = dxgiAdapter->EnumOutputs(screenId, &dxgiOutput);
-        if (FAILED(hr)) return false;
+        if (!findOutput(screenId, dxgiAdapter, dxgiOutput)) return false;
 
-        ComPtr<IDXGIOutput1> dxgiOutput1;
-        hr = dxgiOutput.As(&dxgiOutput1);
-        if (FAILED(hr)) return false;
+        if (!acquireAdapterDevice(dxgiAdapter.Get(), screen.device, screen.context)) return false;
 
-        hr = dxgiOutput1->DuplicateOutput(screen.device.Get(), &screen.duplication);
-        if (FAILED(hr)) return false;
+        DXGI_OUTPUT_DESC outputDesc;
+        if (SUCCEEDED(dxgiOutput->GetDesc(&outputDesc))) {
+            char name[sizeof(outputDesc.DeviceName)] = {};
+            WideCharToMultiByte(CP_ACP, 0, outputDesc.DeviceName, -1, name, sizeof(name), NULL, NULL);
+            screen.outputName = name;
+        }
 
-        DXGI_OUTDUPL_FRAME_INFO frameInfo;
-        ComPtr<IDXGIResource> desktopResource;
-        hr = screen.duplication->AcquireNextFrame(100, &frameInfo, &desktopResource);
-        if (FAILED(hr)) {
-            return false;
+        return SUCCEEDED(dxgiOutput.As(&screen.output));
+    }
+
+    // Duplication de la sortie ouverte. La taille de l'image est relue à la première
+    // capture (voir captureScreen) : pas d'attente d'une première image ici.
+    static HRESULT duplicateOutput(ScreenDevice& screen) {
+        HRESULT hr = screen.output->DuplicateOutput(screen.device.Get(), &screen.duplication);
+        if (FAILED(hr)) return hr;
+        // Ce qui a changé pendant la perte n'est dans aucun rectangle modifié
+        screen.engine.invalidateCache();
+        resetCaptureSlots(screen);
+        return S_OK;
+    }
+
+    // Prépare la capture de l'écran si besoin. Après une perte, les tentatives sont espacées
+    // (RECOVERY_BACKOFF_*) : un appel pendant le délai retourne false tout de suite.
+    bool initializeScreen(int screenId, float reduction) {
+        if (screenId < 0 || reduction <= 0) return false;
+
+        if (screenId >= g_screens.size()) {
+            g_screens.resize(screenId + 1);
         }
 
-        ComPtr<ID3D11Texture2D> desktopTexture;
-        hr = desktopResource.As(&desktopTexture);
-        if (FAILED(hr)) {
-            screen.duplication->ReleaseFrame();
-            return false;
+        ScreenDevice& screen = g_screens[screenId];
+        if (screen.state == CaptureState::Running) return true;
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now < screen.nextAttempt) return false;
+
+        HRESULT hr = E_FAIL;
+        if (screen.state == CaptureState::Lost && screen.output && screen.device) {
+            // Chemin rapide : même périphérique, même sortie
+            hr = duplicateOutput(screen);
+        }
+        else if (openOutput(screenId, screen)) {
+            hr = duplicateOutput(screen);
         }
 
-        D3D11_TEXTURE2D_DESC desc;
-        desktopTexture->GetDesc(&desc);
-        screen.width = desc.Width;
-        screen.height = desc.Height;
-        screen.reducedWidth = static_cast<UINT>(screen.width / reduction);
-        screen.reducedHeight = static_cast<UINT>(screen.height / reduction);
+        if (SUCCEEDED(hr)) {
+            if (!screen.heldColors.empty()) {
+                std::cout << "Capture reprise après " << std::chrono::duration_cast<std::chrono::milliseconds>(now - screen.lostSince).count()
+                    << " ms (" << screen.failedAttempts + 1 << " tentative(s))" << std::endl;
+            }
+            screen.state = CaptureState::Running;
+            screen.failedAttempts = 0;
+            return true;
+        }
+
+        // E_ACCESSDENIED (bureau sécurisé, UAC), DXGI_ERROR_NOT_CURRENTLY_AVAILABLE, session
+        // déconnectée : passager, on réessaie. Sinon la sortie a pu disparaître : tout rouvrir.
+        screen.failedAttempts++;
+        const bool transient = hr == E_ACCESSDENIED || hr == DXGI_ERROR_NOT_CURRENTLY_AVAILABLE
+            || hr == DXGI_ERROR_SESSION_DISCONNECTED || hr == DXGI_ERROR_ACCESS_LOST;
+        if (!transient || screen.failedAttempts >= RECOVERY_FULL_REINIT_AFTER) {
+            screen.output.Reset();
+            screen.state = CaptureState::Closed;
+        }
+        int backoffMs = RECOVERY_BACKOFF_MIN_MS;
+        for (int i = 1; i < screen.failedAttempts && backoffMs < RECOVERY_BACKOFF_MAX_MS; ++i) {
+            backoffMs *= 2;
+        }
+        if (backoffMs > RECOVERY_BACKOFF_MAX_MS) backoffMs = RECOVERY_BACKOFF_MAX_MS;
+        screen.nextAttempt = now + std::chrono::milliseconds(backoffMs);
+        std::cout << "Failed to initialize screen " << screenId << " (0x" << std::hex << static_cast<unsigned long>(hr) << std::dec
+            << "), nouvel essai dans " << backoffMs << " ms" << std::endl;
+        return false;
+    }
 
+    // Crée une texture de staging lisible par le CPU
+    static bool createStagingTexture(ScreenDevice& screen, UINT width, UINT height, ComPtr<ID3D11Texture2D>& texture) {
         D3D11_TEXTURE2D_DESC stagingDesc = {};
-        stagingDesc.Width = desc.Width;
-        stagingDesc.Height = desc.Height;
+        stagingDesc.Width = width;
+        stagingDesc.Height = height;
         stagingDesc.MipLevels = 1;
         stagingDesc.ArraySize = 1;
         stagingDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
@@ -106,523 +345,703 @@ extern "C" {
         stagingDesc.Usage = D3D11_USAGE_STAGING;
         stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
 
-        hr = screen.device->CreateTexture2D(&stagingDesc, nullptr, &screen.stagingTexture);
-        if (FAILED(hr)) {
-            screen.duplication->ReleaseFrame();
+        HRESULT hr = screen.device->CreateTexture2D(&stagingDesc, nullptr, &texture);
+        return SUCCEEDED(hr);
+    }
+
+    // Prépare l'atlas des bordures et la texture de staging du slot pour la géométrie courante.
+    // Retourne false si l'atlas ne s'applique pas : il faut copier l'image complète.
+    static bool prepareBorderAtlas(ScreenDevice& screen, const SamplingLayout& layout, CaptureSlot& slot) {
+        if (!screen.useBorderAtlas) return false;
+
+        if (!(screen.atlas.key == layout.key)) {
+            const UINT previousWidth = screen.atlas.width;
+            const UINT previousHeight = screen.atlas.height;
+            const bool built = screen.atlas.build(layout);
+            if (!built || screen.atlas.width != previousWidth || screen.atlas.height != previousHeight) {
+                // Une copie en attente dans l'ancien atlas ne peut plus être lue
+                for (CaptureSlot& other : screen.slots) {
+                    other.atlasTexture.Reset();
+                    if (other.useAtlas) other.pending = false;
+                }
+            }
+            if (!built) return false;
+        }
+        if (!screen.atlas.valid) return false;
+
+        if (!slot.atlasTexture && !createStagingTexture(screen, screen.atlas.width, screen.atlas.height, slot.atlasTexture)) {
+            screen.useBorderAtlas = false;
             return false;
         }
+        return true;
+    }
+
+    // Lit les move rects et dirty rects de l'image acquise dans screen.frameRects.
+    // Pour un move rect seule la destination change. Retourne false si DXGI échoue.
+    static bool readFrameRects(ScreenDevice& screen, const DXGI_OUTDUPL_FRAME_INFO& frameInfo) {
+        screen.frameRects.clear();
+        if (screen.metadataBuffer.size() < frameInfo.TotalMetadataBufferSize) {
+            screen.metadataBuffer.resize(frameInfo.TotalMetadataBufferSize);
+        }
+        const UINT bufferSize = static_cast<UINT>(screen.metadataBuffer.size());
 
-        screen.pixelBuffer.resize(screen.reducedWidth * screen.reducedHeight);
+        UINT moveBytes = 0;
+        auto* moveRects = reinterpret_cast<DXGI_OUTDUPL_MOVE_RECT*>(screen.metadataBuffer.data());
+        HRESULT hr = screen.duplication->GetFrameMoveRects(bufferSize, moveRects, &moveBytes);
+        if (FAILED(hr)) return false;
 
-        screen.duplication->ReleaseFrame();
-        screen.initialized = true;
+        UINT dirtyBytes = 0;
+        auto* dirtyRects = reinterpret_cast<RECT*>(screen.metadataBuffer.data() + moveBytes);
+        hr = screen.duplication->GetFrameDirtyRects(bufferSize - moveBytes, dirtyRects, &dirtyBytes);
+        if (FAILED(hr)) return false;
 
+        const UINT moveCount = moveBytes / sizeof(DXGI_OUTDUPL_MOVE_RECT);
+        const UINT dirtyCount = dirtyBytes / sizeof(RECT);
+        screen.frameRects.reserve(moveCount + dirtyCount);
+        for (UINT i = 0; i < moveCount; ++i) {
+            const RECT& rect = moveRects[i].DestinationRect;
+            screen.frameRects.push_back({ rect.left, rect.top, rect.right, rect.bottom });
+        }
+        for (UINT i = 0; i < dirtyCount; ++i) {
+            const RECT& rect = dirtyRects[i];
+            screen.frameRects.push_back({ rect.left, rect.top, rect.right, rect.bottom });
+        }
         return true;
     }
 
-    struct PixelResult {
-        int* pixels;
-        int size;
-    };
+    // Lance la copie GPU de l'image acquise vers les textures du slot, sans attendre le GPU.
+    // rects : rectangles modifiés depuis l'image précédente, ou nullptr si tout est à recalculer.
+    static bool issueCapture(ScreenDevice& screen, const SamplingLayout& layout, ID3D11Texture2D* desktopTexture,
+        CaptureSlot& slot, const std::vector<FrameRect>* rects) {
+        stageTimer copyTimer(Stage::Copy);
 
-    __declspec(dllexport)
-        PixelResult getScreenPixels(int screenId, int ledX, int ledY, int keepPixels, float reduction) {
-        PixelResult result = { nullptr, -1 };
+        // Seulement les bordures quand l'atlas s'applique
+        slot.useAtlas = prepareBorderAtlas(screen, layout, slot);
+        if (!slot.useAtlas && !slot.stagingTexture
+            && !createStagingTexture(screen, screen.width, screen.height, slot.stagingTexture)) {
+            return false;
+        }
+
+        ID3D11Texture2D* readbackTexture = slot.useAtlas ? slot.atlasTexture.Get() : slot.stagingTexture.Get();
+        if (slot.useAtlas) {
+            for (const AtlasStrip& strip : screen.atlas.strips) {
+                D3D11_BOX box = { strip.srcLeft, strip.srcTop, 0, strip.srcRight, strip.srcBottom, 1 };
+                screen.context->CopySubresourceRegion(readbackTexture, 0, strip.atlasX, strip.atlasY, 0,
+                    desktopTexture, 0, &box);
+            }
+        }
+        else {
+            screen.context->CopyResource(readbackTexture, desktopTexture);
+        }
+
+        slot.allDirty = rects == nullptr;
+        if (rects) {
+            slot.rects.assign(rects->begin(), rects->end());
+        }
+        slot.key = layout.key;
+        slot.pending = true;
+        return true;
+    }
+
+    // Lit une copie en attente et échantillonne ses bordures dans le buffer arrière, puis
+    // l'échange avec le buffer avant. wait = false : si le GPU n'a pas fini, retourne nullptr
+    // sans bloquer et le slot reste en attente. Retourne nullptr aussi en cas d'échec.
+    static std::vector<int>* resolveCapture(ScreenDevice& screen, CaptureSlot& slot, const SamplingParams& params, bool wait) {
+        ID3D11Texture2D* readbackTexture = slot.useAtlas ? slot.atlasTexture.Get() : slot.stagingTexture.Get();
+        D3D11_MAPPED_SUBRESOURCE mapped;
+        stageTimer mapTimer(Stage::Map);
+        HRESULT hr = screen.context->Map(readbackTexture, 0, D3D11_MAP_READ, wait ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+        if (hr == DXGI_ERROR_WAS_STILL_DRAWING) {
+            return nullptr;
+        }
+        mapTimer.stop();
+        slot.pending = false;
+        if (FAILED(hr)) {
+            // Image perdue : les rectangles des copies suivantes ne sont plus relatifs
+            // à la dernière image échantillonnée
+            for (CaptureSlot& other : screen.slots) {
+                other.allDirty = true;
+            }
+            return nullptr;
+        }
+
+        // Les paramètres ont changé depuis la copie : elle ne correspond plus à la géométrie
+        const SamplingLayout* layout = screen.engine.prepare(screen.width, screen.height, params);
+        if (!layout || !(layout->key == slot.key)) {
+            screen.context->Unmap(readbackTexture, 0);
+            return nullptr;
+        }
+
+        // Les rectangles sont relatifs à l'image précédente, qui est la dernière échantillonnée
+        if (slot.allDirty) {
+            screen.engine.markAllDirty();
+        }
+        else {
+            screen.engine.markDirty(slot.rects.data(), slot.rects.size());
+        }
+
+        // Échantillonnage des bords par le moteur indépendant de l'OS
+        FrameView frame;
+        if (slot.useAtlas) {
+            frame = screen.atlas.view(static_cast<const uint8_t*>(mapped.pData), mapped.RowPitch);
+        }
+        else {
+            frame.data = static_cast<const uint8_t*>(mapped.pData);
+            frame.rowPitch = mapped.RowPitch;
+            frame.width = screen.width;
+            frame.height = screen.height;
+        }
+
+        std::vector<int>& ledColors = screen.ledBuffers[1 - screen.frontBuffer];
+        stageTimer sampleTimer(Stage::Sample);
+        bool sampled = screen.engine.sample(frame, params, ledColors);
+        sampleTimer.stop();
+        screen.context->Unmap(readbackTexture, 0);
+        if (!sampled) {
+            return nullptr;
+        }
+
+        // Le buffer arrière devient le buffer avant
+        screen.frontBuffer = 1 - screen.frontBuffer;
+        screen.frontLedX = params.ledX;
+        screen.frontLedY = params.ledY;
+        return &ledColors;
+    }
+
+    // Index de la plus ancienne copie en attente, ou -1
+    static int oldestPendingSlot(const ScreenDevice& screen) {
+        for (int i = 0; i < CAPTURE_RING_SIZE; ++i) {
+            const int index = (screen.nextSlot + i) % CAPTURE_RING_SIZE;
+            if (screen.slots[index].pending) return index;
+        }
+        return -1;
+    }
+
+    // Capture une image et calcule les couleurs des LEDs dans le buffer arrière de l'écran,
+    // puis l'échange avec le buffer avant. Retourne le buffer avant, ou nullptr en cas d'échec.
+    //
+    // Pipeline : la copie GPU de l'image acquise est lancée et l'image DXGI libérée tout de
+    // suite, puis le CPU lit la copie lancée à l'appel précédent (déjà terminée). Les couleurs
+    // retournées ont donc une image de retard, mais Map n'attend plus la copie. Si aucune
+    // copie plus ancienne n'est prête, le dernier résultat est retourné tel quel.
+    static std::vector<int>* captureScreen(int screenId, int ledX, int ledY, int keepPixels, float reduction,
+        SamplingFilter filter) {
 
-        // Timestamp global pour la fonction entière
-        auto startTotal = std::chrono::high_resolution_clock::now();
+        // Durée totale, enregistrée à la sortie (voir stageStats.cpp)
+        stageTimer totalTimer(Stage::Capture);
 
-        // Timing pour l'initialisation
-        auto startInit = std::chrono::high_resolution_clock::now();
         if (!initializeScreen(screenId, reduction)) {
-            std::cout << "Failed to initialize screen" << std::endl;
-            return result;
+            if (screenId < 0 || screenId >= g_screens.size()) return nullptr;
+            // Reprise en cours : dernière image en fondu plutôt qu'une coupure
+            g_screens[screenId].presented = false;
+            return heldColorsFaded(g_screens[screenId], ledX, ledY);
         }
-        auto endInit = std::chrono::high_resolution_clock::now();
-        auto microsInit = std::chrono::duration_cast<std::chrono::microseconds>(endInit - startInit).count();
-        //std::cout << "Initialization time: " << microsInit << " μs" << std::endl;
 
         ScreenDevice& screen = g_screens[screenId];
 
-        // Timing pour l'acquisition du frame
-        auto startAcquire = std::chrono::high_resolution_clock::now();
+        SamplingParams params;
+        params.ledX = ledX;
+        params.ledY = ledY;
+        params.keepPixels = keepPixels;
+        params.reduction = reduction;
+        params.filter = filter;
+
         DXGI_OUTDUPL_FRAME_INFO frameInfo;
         ComPtr<IDXGIResource> desktopResource;
-        HRESULT hr = screen.duplication->AcquireNextFrame(10, &frameInfo, &desktopResource);
+        stageTimer acquireTimer(Stage::Acquire);
+        HRESULT hr = screen.duplication->AcquireNextFrame(screen.acquireTimeoutMs, &frameInfo, &desktopResource);
+        acquireTimer.stop();
+        screen.presented = SUCCEEDED(hr) && frameInfo.LastPresentTime.QuadPart != 0;
         if (FAILED(hr)) {
-            screen.duplication->ReleaseFrame();
-            if (hr == 0x887a0026) {
-                std::cout << "error reload" << std::endl;
-                screen.duplication.Reset();
-                screen.stagingTexture.Reset();
-                screen.initialized = false;
+            // Aucune image n'est tenue : pas de ReleaseFrame
+            if (hr != DXGI_ERROR_WAIT_TIMEOUT) {
+                // Accès perdu : la sortie seule est à redupliquer. Autre erreur (périphérique
+                // retiré ou réinitialisé) : tout est rouvert.
+                const bool deviceLost = hr != DXGI_ERROR_ACCESS_LOST && hr != DXGI_ERROR_INVALID_CALL;
+                std::cout << (deviceLost ? "Capture perdue" : "Accès perdu") << " (0x" << std::hex
+                    << static_cast<unsigned long>(hr) << std::dec << "), reprise" << std::endl;
+                suspendCapture(screen, deviceLost);
+                return heldColorsFaded(screen, ledX, ledY);
             }
-            return result;
+            // Pas de nouvelle image : terminer la copie encore en attente
+            const int pending = oldestPendingSlot(screen);
+            if (pending >= 0) {
+                return resolveCapture(screen, screen.slots[pending], params, true);
+            }
+            return nullptr;
         }
-        auto endAcquire = std::chrono::high_resolution_clock::now();
-        auto microsAcquire = std::chrono::duration_cast<std::chrono::microseconds>(endAcquire - startAcquire).count();
-        //std::cout << "Frame acquisition time: " << microsAcquire << " μs" << std::endl;
 
-        // Timing pour la conversion de ressource
-        auto startConvert = std::chrono::high_resolution_clock::now();
         ComPtr<ID3D11Texture2D> desktopTexture;
         hr = desktopResource.As(&desktopTexture);
         if (FAILED(hr)) {
             screen.duplication->ReleaseFrame();
-            return result;
+            return nullptr;
         }
-        auto endConvert = std::chrono::high_resolution_clock::now();
-        auto microsConvert = std::chrono::duration_cast<std::chrono::microseconds>(endConvert - startConvert).count();
-       // std::cout << "Resource conversion time: " << microsConvert << " μs" << std::endl;
 
-        // Timing pour la copie de ressource
-        auto startCopy = std::chrono::high_resolution_clock::now();
-        screen.context->CopyResource(screen.stagingTexture.Get(), desktopTexture.Get());
-        auto endCopy = std::chrono::high_resolution_clock::now();
-        auto microsCopy = std::chrono::duration_cast<std::chrono::microseconds>(endCopy - startCopy).count();
-        //std::cout << "Resource copy time: " << microsCopy << " μs" << std::endl;
+        D3D11_TEXTURE2D_DESC desc;
+        desktopTexture->GetDesc(&desc);
+        if (desc.Width != screen.width || desc.Height != screen.height) {
+            // Première image ou nouveau mode d'écran : la géométrie d'échantillonnage sera reconstruite
+            screen.width = desc.Width;
+            screen.height = desc.Height;
+            screen.engine.invalidateLayout();
+            screen.atlas = BorderAtlas();
+            resetCaptureSlots(screen);
+        }
 
-        // Timing pour le mapping de texture
-        auto startMap = std::chrono::high_resolution_clock::now();
-        D3D11_MAPPED_SUBRESOURCE mapped;
-        hr = screen.context->Map(screen.stagingTexture.Get(), 0, D3D11_MAP_READ, 0, &mapped);
-        if (FAILED(hr)) {
+        const SamplingLayout* layout = screen.engine.prepare(screen.width, screen.height, params);
+        if (!layout) {
             screen.duplication->ReleaseFrame();
-            return result;
+            return nullptr;
         }
-        auto endMap = std::chrono::high_resolution_clock::now();
-        auto microsMap = std::chrono::duration_cast<std::chrono::microseconds>(endMap - startMap).count();
-        //std::cout << "Texture mapping time: " << microsMap << " μs" << std::endl;
-
-        auto* pixels = static_cast<unsigned char*>(mapped.pData);
-
-        // Préparation des variables
-        auto startPrepare = std::chrono::high_resolution_clock::now();
-        float xScale = static_cast<float>(screen.width) / screen.reducedWidth;
-        float yScale = static_cast<float>(screen.height) / screen.reducedHeight;
-        UINT keepWidth = static_cast<UINT>(keepPixels);
-        UINT keepHeight = static_cast<UINT>(keepPixels);
-        UINT leftBound = keepWidth;
-        UINT rightBound = screen.reducedWidth - keepWidth;
-        UINT topBound = keepHeight;
-        UINT bottomBound = screen.reducedHeight - keepHeight;
-        auto endPrepare = std::chrono::high_resolution_clock::now();
-        auto microsPrepare = std::chrono::duration_cast<std::chrono::microseconds>(endPrepare - startPrepare).count();
-        //std::cout << "Variables preparation time: " << microsPrepare << " μs" << std::endl;
-
-        // Optimisation combinée: accès mémoire optimisés + élimination des branches conditionnelles
-        auto startFill = std::chrono::high_resolution_clock::now();
-
-        // 1. Remplir tout le buffer avec des zéros d'un coup (plus rapide qu'une boucle)
-        std::memset(screen.pixelBuffer.data(), 0, screen.pixelBuffer.size() * sizeof(int));
-
-        // 2. Traiter les bordures par segments contigus (meilleure localité de cache)
-        // Bord supérieur
-        for (UINT y = 0; y < topBound; ++y) {
-            const UINT baseY = static_cast<UINT>(y * yScale);
-            const unsigned char* const rowPtr = pixels + (baseY * mapped.RowPitch);
-            int* const destRowPtr = screen.pixelBuffer.data() + (y * screen.reducedWidth);
-
-            for (UINT x = 0; x < screen.reducedWidth; ++x) {
-                const UINT srcX = static_cast<UINT>(x * xScale);
-                const unsigned char* const pixelPtr = rowPtr + (srcX * 4);
-
-                // Lecture séquentielle pour une meilleure performance de cache
-                const unsigned char b = pixelPtr[0];
-                const unsigned char g = pixelPtr[1];
-                const unsigned char r = pixelPtr[2];
-
-                destRowPtr[x] = (r << 16) | (g << 8) | b;
+
+        // Échantillonnage incrémental : sans nouvelle image (LastPresentTime nul, seul le curseur
+        // a bougé) ou sans rectangle modifié dans les bordures, ni copie ni Map
+        const std::vector<FrameRect>* rects = nullptr;
+        if (screen.useDirtyRects) {
+            size_t dirtyZoneCount = layout->zones.size();
+            if (frameInfo.LastPresentTime.QuadPart == 0) {
+                screen.frameRects.clear();
+                rects = &screen.frameRects;
+                dirtyZoneCount = screen.engine.markDirty(nullptr, 0);
+            }
+            else if (frameInfo.TotalMetadataBufferSize > 0 && readFrameRects(screen, frameInfo)) {
+                rects = &screen.frameRects;
+                dirtyZoneCount = screen.engine.markDirty(screen.frameRects.data(), screen.frameRects.size());
+            }
+
+            if (dirtyZoneCount == 0) {
+                // Image identique à la précédente dans les bordures : son résultat suffit
+                const int pending = oldestPendingSlot(screen);
+                if (pending >= 0) {
+                    screen.duplication->ReleaseFrame();
+                    return resolveCapture(screen, screen.slots[pending], params, true);
+                }
+                std::vector<int>& ledColors = screen.ledBuffers[1 - screen.frontBuffer];
+                if (screen.engine.copyCached(ledColors)) {
+                    screen.duplication->ReleaseFrame();
+                    screen.frontBuffer = 1 - screen.frontBuffer;
+                    screen.frontLedX = ledX;
+                    screen.frontLedY = ledY;
+                    return &ledColors;
+                }
             }
         }
 
-        // Bord inférieur (y compris la partie droite/gauche qui se recoupe avec le haut/bas)
-        for (UINT y = bottomBound; y < screen.reducedHeight; ++y) {
-            const UINT baseY = static_cast<UINT>(y * yScale);
-            const unsigned char* const rowPtr = pixels + (baseY * mapped.RowPitch);
-            int* const destRowPtr = screen.pixelBuffer.data() + (y * screen.reducedWidth);
+        // Anneau plein : lire la plus ancienne copie avant de réutiliser son slot
+        const int issued = screen.nextSlot;
+        CaptureSlot& slot = screen.slots[issued];
+        std::vector<int>* result = nullptr;
+        if (slot.pending) {
+            result = resolveCapture(screen, slot, params, true);
+        }
 
-            for (UINT x = 0; x < screen.reducedWidth; ++x) {
-                const UINT srcX = static_cast<UINT>(x * xScale);
-                const unsigned char* const pixelPtr = rowPtr + (srcX * 4);
+        const bool copied = issueCapture(screen, *layout, desktopTexture.Get(), slot, rects);
+        // La copie est dans la file du GPU : l'image peut être rendue à DXGI tout de suite
+        screen.duplication->ReleaseFrame();
+        if (!copied) {
+            return nullptr;
+        }
+        screen.nextSlot = (issued + 1) % CAPTURE_RING_SIZE;
 
-                const unsigned char b = pixelPtr[0];
-                const unsigned char g = pixelPtr[1];
-                const unsigned char r = pixelPtr[2];
+        // Lire les copies plus anciennes (terminées depuis l'appel précédent), dans l'ordre
+        for (int pending = oldestPendingSlot(screen); pending >= 0 && pending != issued; pending = oldestPendingSlot(screen)) {
+            std::vector<int>* colors = resolveCapture(screen, screen.slots[pending], params, true);
+            if (colors) {
+                result = colors;
+            }
+        }
 
-                destRowPtr[x] = (r << 16) | (g << 8) | b;
+        // La copie qui vient d'être lancée n'est lue que si le GPU a déjà fini ; sinon elle
+        // reste en vol jusqu'au prochain appel
+        if (!result) {
+            result = resolveCapture(screen, slot, params, false);
+        }
+        if (!result && !slot.pending) {
+            return nullptr;
+        }
+        if (!result) {
+            // Première image du pipeline : le dernier résultat, s'il existe, reste valable
+            std::vector<int>& front = screen.ledBuffers[screen.frontBuffer];
+            if (front.size() != layout->zones.size()) {
+                return nullptr;
             }
+            result = &front;
         }
 
-        // Bords gauche et droit (sans les rangées déjà traitées)
-        for (UINT y = topBound; y < bottomBound; ++y) {
-            const UINT baseY = static_cast<UINT>(y * yScale);
-            const unsigned char* const rowPtr = pixels + (baseY * mapped.RowPitch);
-            int* const destRowPtr = screen.pixelBuffer.data() + (y * screen.reducedWidth);
+        return result;
+    }
 
-            // Bord gauche
-            for (UINT x = 0; x < leftBound; ++x) {
-                const UINT srcX = static_cast<UINT>(x * xScale);
-                const unsigned char* const pixelPtr = rowPtr + (srcX * 4);
+    // Capture tous les écrans de mapping en parallèle, un participant par écran : chacun a sa
+    // duplication, ses textures et son moteur, seul le périphérique de la carte est partagé.
+    // colors[i] / sizes[i] : buffer avant de mapping.screens[i] (voir captureScreen), ou
+    // nullptr / -1 si sa capture a échoué.
+    static void captureScreens(const StripMapping& mapping, std::vector<const int*>& colors, std::vector<int>& sizes) {
+        const int count = static_cast<int>(mapping.screens.size());
+        colors.assign(count, nullptr);
+        sizes.assign(count, -1);
+
+        // g_screens ne doit plus être redimensionné une fois les threads lancés
+        for (const ScreenZones& zones : mapping.screens) {
+            if (zones.screenId >= g_screens.size()) {
+                g_screens.resize(zones.screenId + 1);
+            }
+        }
 
-                const unsigned char b = pixelPtr[0];
-                const unsigned char g = pixelPtr[1];
-                const unsigned char r = pixelPtr[2];
+        // Les cœurs sont partagés entre les écrans capturés en même temps : chaque moteur
+        // n'a que sa part, le coût CPU total reste celui d'un seul écran
+        const unsigned cores = std::thread::hardware_concurrency();
+        const unsigned perScreen = cores / static_cast<unsigned>(count);
+        const unsigned share = count == 1 ? 0 : (perScreen > 1 ? perScreen : 1);
+        for (const ScreenZones& zones : mapping.screens) {
+            g_screens[zones.screenId].engine.setParticipants(share);
+        }
 
-                destRowPtr[x] = (r << 16) | (g << 8) | b;
+        auto captureOne = [&](int i) {
+            const ScreenZones& zones = mapping.screens[i];
+            std::vector<int>* ledColors = captureScreen(zones.screenId, zones.ledX, zones.ledY, zones.keepPixels, zones.reduction, zones.filter);
+            if (ledColors) {
+                colors[i] = ledColors->data();
+                sizes[i] = static_cast<int>(ledColors->size());
             }
+        };
 
-            // Bord droit
-            for (UINT x = rightBound; x < screen.reducedWidth; ++x) {
-                const UINT srcX = static_cast<UINT>(x * xScale);
-                const unsigned char* const pixelPtr = rowPtr + (srcX * 4);
-
-                const unsigned char b = pixelPtr[0];
-                const unsigned char g = pixelPtr[1];
-                const unsigned char r = pixelPtr[2];
+        if (count == 1) {
+            captureOne(0);
+            return;
+        }
+        if (!g_capturePool || g_capturePool->size() != static_cast<unsigned>(count)) {
+            g_capturePool.reset(new workerPool(count - 1));
+        }
+        g_capturePool->run(count, captureOne);
+    }
 
-                destRowPtr[x] = (r << 16) | (g << 8) | b;
-            }
+    // Délai d'attente d'une nouvelle image pour les prochaines captures de cet écran
+    static void setAcquireTimeout(int screenId, UINT timeoutMs) {
+        if (screenId < 0) return;
+        if (screenId >= g_screens.size()) {
+            g_screens.resize(screenId + 1);
         }
-        auto endFill = std::chrono::high_resolution_clock::now();
-        auto microsFill = std::chrono::duration_cast<std::chrono::microseconds>(endFill - startFill).count();
-        //std::cout << "Pixel buffer filling time: " << microsFill << " μs" << std::endl;
+        g_screens[screenId].acquireTimeoutMs = timeoutMs;
+    }
 
-        // Initialisation pour calcul des moyennes
-        auto startAvgInit = std::chrono::high_resolution_clock::now();
-        
-        float topBottomZoneWidth = static_cast<float>(screen.reducedWidth) / ledX;
-        float leftRightZoneHeight = static_cast<float>(screen.reducedHeight) / ledY;
-        auto endAvgInit = std::chrono::high_resolution_clock::now();
-        auto microsAvgInit = std::chrono::duration_cast<std::chrono::microseconds>(endAvgInit - startAvgInit).count();
-        //std::cout << "Average calculation init time: " << microsAvgInit << " μs" << std::endl;
+    // La dernière capture de cet écran a-t-elle reçu une nouvelle image du bureau ?
+    static bool lastCapturePresented(int screenId) {
+        return screenId >= 0 && screenId < g_screens.size() && g_screens[screenId].presented;
+    }
 
-        // Version optimisée des calculs de bords
-        auto startEdgeCalc = std::chrono::high_resolution_clock::now();
+    // Latences par étape (voir stageStats.cpp), en microsecondes
+    struct StageStat {
+        int stage;
+        const char* name;
+        unsigned long long count;
+        unsigned int p50Us;
+        unsigned int p95Us;
+        unsigned int p99Us;
+        unsigned int maxUs;
+    };
 
-        // Pré-allouer le tableau de couleurs des LEDs
-        std::vector<int> ledColors(ledX * 2 + ledY * 2, 0);
+    // Active ou coupe la mesure des latences (coupée par défaut)
+    __declspec(dllexport)
+        void enableStageStats(int enabled) {
+        setStageStatsEnabled(enabled != 0);
+    }
 
-        // 1. Utiliser un accès séquentiel optimisé pour les mémoires
-        // 2. Précomputer les limites de zones une seule fois
-        // 3. Réduire les opérations de division en utilisant des incréments
+    // Copie un résumé par étape dans out. reset != 0 remet les histogrammes à zéro.
+    // Retourne le nombre d'étapes écrites, ou -1 si out est trop petit.
+    __declspec(dllexport)
+        int getStageStats(StageStat* out, int capacity, int reset) {
+        const int stageCount = static_cast<int>(Stage::Count);
+        if (!out || capacity < stageCount) return -1;
+
+        for (int i = 0; i < stageCount; ++i) {
+            const Stage stage = static_cast<Stage>(i);
+            const StageSummary summary = stageHistogram(stage).summary(reset != 0);
+            out[i].stage = i;
+            out[i].name = stageName(stage);
+            out[i].count = summary.count;
+            out[i].p50Us = summary.p50;
+            out[i].p95Us = summary.p95;
+            out[i].p99Us = summary.p99;
+            out[i].maxUs = summary.max;
+        }
+        return stageCount;
+    }
 
-        // Structure pour précalculer les zones
-        struct ZoneInfo {
-            UINT startX, endX, startY, endY;
-        };
+    // Résultat de captureScreen à la taille demandée : une image tenue pendant une reprise
+    // peut venir d'une autre disposition et n'est alors pas rendue à l'appelant
+    static bool matchesLayout(const std::vector<int>* ledColors, int ledX, int ledY) {
+        return ledColors && ledX > 0 && ledY > 0 && ledColors->size() == static_cast<size_t>(ledCount(ledX, ledY));
+    }
 
-        // Pré-calculer toutes les zones pour chaque LED
-        std::vector<ZoneInfo> topZones(ledX);
-        std::vector<ZoneInfo> rightZones(ledY);
-        std::vector<ZoneInfo> bottomZones(ledX);
-        std::vector<ZoneInfo> leftZones(ledY);
-
-        // Pré-calcul des zones pour les bords
-        for (int i = 0; i < ledX; ++i) {
-            // Zones supérieures
-            topZones[i].startX = static_cast<UINT>(i * topBottomZoneWidth);
-            topZones[i].endX = static_cast<UINT>((i + 1) * topBottomZoneWidth);
-            topZones[i].startY = 0;
-            topZones[i].endY = topBound;
-
-            // Zones inférieures (de droite à gauche)
-            bottomZones[i].startX = screen.reducedWidth - static_cast<UINT>((i + 1) * topBottomZoneWidth);
-            bottomZones[i].endX = screen.reducedWidth - static_cast<UINT>(i * topBottomZoneWidth);
-            bottomZones[i].startY = bottomBound;
-            bottomZones[i].endY = screen.reducedHeight;
-        }
-
-        for (int i = 0; i < ledY; ++i) {
-            // Zones droites
-            rightZones[i].startX = rightBound;
-            rightZones[i].endX = screen.reducedWidth;
-            rightZones[i].startY = static_cast<UINT>(i * leftRightZoneHeight);
-            rightZones[i].endY = static_cast<UINT>((i + 1) * leftRightZoneHeight);
-
-            // Zones gauches (de bas en haut)
-            leftZones[i].startX = 0;
-            leftZones[i].endX = leftBound;
-            leftZones[i].startY = screen.reducedHeight - static_cast<UINT>((i + 1) * leftRightZoneHeight);
-            leftZones[i].endY = screen.reducedHeight - static_cast<UINT>(i * leftRightZoneHeight);
-        }
-
-        // Traitement parallèle des 4 bords en utilisant std::thread si disponible
-        #ifdef USE_PARALLEL
-        // Version parallèle avec 4 threads (un par bord)
-        std::thread topThread, rightThread, bottomThread, leftThread;
-
-        auto calcZoneAverage = [&screen](const std::vector<ZoneInfo>& zones, std::vector<int>& ledColors, int offset) {
-        #else
-        auto calcZoneAverage = [&screen](const std::vector<ZoneInfo>& zones, std::vector<int>& ledColors, int offset) {
-        #endif
-            for (size_t i = 0; i < zones.size(); ++i) {
-                const auto& zone = zones[i];
-
-                // Utiliser des variables accumulateurs 32 bits si possible pour éviter les conversions
-                int rSum = 0, gSum = 0, bSum = 0;
-                int count = 0;
-
-                // Optimisation: calculer directement l'adresse de début de ligne
-                const int* bufferStart = screen.pixelBuffer.data();
-
-                // Traiter ligne par ligne pour une meilleure localité de cache
-                for (UINT y = zone.startY; y < zone.endY && y < screen.reducedHeight; ++y) {
-                    const int* rowStart = bufferStart + (y * screen.reducedWidth);
-
-                    for (UINT x = zone.startX; x < zone.endX && x < screen.reducedWidth; ++x) {
-                        // Accès direct au pixel sans multiplication dans la boucle intérieure
-                        int pixel = rowStart[x];
-
-                        // Extraction des composantes en une seule passe avec masques
-                        rSum += (pixel >> 16) & 0xFF;
-                        gSum += (pixel >> 8) & 0xFF;
-                        bSum += pixel & 0xFF;
-                        ++count;
-                    }
-                }
+    // Les points d'entrée exportés gardent l'échantillonnage d'origine (Nearest) : un hôte qui
+    // passe reduction > 1 pour gagner du temps lit toujours moins de pixels. La moyenne exacte
+    // (Area) se choisit dans le profil du bureau.
+    struct PixelResult {
+        int* pixels;
+        int size;
+    };
 
-                // Éviter la division si count est 0
-                if (count > 0) {
-                    // Division une seule fois à la fin
-                    rSum /= count;
-                    gSum /= count;
-                    bSum /= count;
-                    ledColors[offset + i] = (rSum << 16) | (gSum << 8) | bSum;
-                }
-            }
-            };
-
-        #ifdef USE_PARALLEL
-        // Lancer les threads parallèles
-        topThread = std::thread(calcZoneAverage, std::ref(topZones), std::ref(ledColors), 0);
-        rightThread = std::thread(calcZoneAverage, std::ref(rightZones), std::ref(ledColors), ledX);
-        bottomThread = std::thread(calcZoneAverage, std::ref(bottomZones), std::ref(ledColors), ledX + ledY);
-        leftThread = std::thread(calcZoneAverage, std::ref(leftZones), std::ref(ledColors), ledX * 2 + ledY);
-
-        // Attendre tous les threads
-        topThread.join();
-        rightThread.join();
-        bottomThread.join();
-        leftThread.join();
-        #else
-        // Version séquentielle optimisée
-        calcZoneAverage(topZones, ledColors, 0);
-        calcZoneAverage(rightZones, ledColors, ledX);
-        calcZoneAverage(bottomZones, ledColors, ledX + ledY);
-        calcZoneAverage(leftZones, ledColors, ledX * 2 + ledY);
-        #endif
-
-        auto endEdgeCalc = std::chrono::high_resolution_clock::now();
-        auto microsEdgeCalc = std::chrono::duration_cast<std::chrono::microseconds>(endEdgeCalc - startEdgeCalc).count();
-
-
-        // Timing pour le nettoyage et libération des ressources
-        auto startCleanup = std::chrono::high_resolution_clock::now();
-        screen.context->Unmap(screen.stagingTexture.Get(), 0);
-        screen.duplication->ReleaseFrame();
-        auto endCleanup = std::chrono::high_resolution_clock::now();
-        auto microsCleanup = std::chrono::duration_cast<std::chrono::microseconds>(endCleanup - startCleanup).count();
-        //std::cout << "Resource cleanup time: " << microsCleanup << " μs" << std::endl;
-
-        // Timing pour l'allocation du tableau de résultats
-        auto startAlloc = std::chrono::high_resolution_clock::now();
-        int* ledColorsArray = new int[ledColors.size()];
-        std::copy(ledColors.begin(), ledColors.end(), ledColorsArray);
-        result.pixels = ledColorsArray;
-        result.size = ledColors.size();
-        auto endAlloc = std::chrono::high_resolution_clock::now();
-        auto microsAlloc = std::chrono::duration_cast<std::chrono::microseconds>(endAlloc - startAlloc).count();
-        //std::cout << "Result allocation time: " << microsAlloc << " μs" << std::endl;
-
-        // Affichage du temps total
-        auto endTotal = std::chrono::high_resolution_clock::now();
-        auto microsTotal = std::chrono::duration_cast<std::chrono::microseconds>(endTotal - startTotal).count();
-        //std::cout << "Total function time: " << microsTotal << " μs (" << microsTotal / 1000.0 << " ms)" << std::endl;
-
-        // Résumé des pourcentages de temps
-        //std::cout << "Time breakdown (%):" << std::endl;
-        //std::cout << "  Initialization: " << (microsInit * 100.0 / microsTotal) << "%" << std::endl;
-        //std::cout << "  Frame acquisition: " << (microsAcquire * 100.0 / microsTotal) << "%" << std::endl;
-        //std::cout << "  Resource conversion: " << (microsConvert * 100.0 / microsTotal) << "%" << std::endl;
-        //std::cout << "  Resource copy: " << (microsCopy * 100.0 / microsTotal) << "%" << std::endl;
-        //std::cout << "  Texture mapping: " << (microsMap * 100.0 / microsTotal) << "%" << std::endl;
-        //std::cout << "  Pixel buffer filling: " << (microsFill * 100.0 / microsTotal) << "%" << std::endl;
-        //std::cout << "  Edge calculations time: " << (microsEdgeCalc * 100.0 / microsTotal) << "%" << std::endl;
+    // Ancienne API : alloue un nouveau tableau à chaque appel, à libérer avec freeMemory
+    __declspec(dllexport)
+        PixelResult getScreenPixels(int screenId, int ledX, int ledY, int keepPixels, float reduction) {
+        PixelResult result = { nullptr, -1 };
 
+        std::vector<int>* ledColors = captureScreen(screenId, ledX, ledY, keepPixels, reduction, SamplingFilter::Nearest);
+        if (!matchesLayout(ledColors, ledX, ledY)) {
+            return result;
+        }
+
+        int* ledColorsArray = new int[ledColors->size()];
+        std::copy(ledColors->begin(), ledColors->end(), ledColorsArray);
+        result.pixels = ledColorsArray;
+        result.size = static_cast<int>(ledColors->size());
         return result;
     }
 
+    // Nombre de couleurs produites pour une bande ledX x ledY (taille du buffer à fournir)
     __declspec(dllexport)
-        void freeMemory(const char* ptr) {
-        delete[] reinterpret_cast<const int*>(ptr);
+        int getLedCount(int ledX, int ledY) {
+        if (ledX <= 0 || ledY <= 0) return 0;
+        return ledCount(ledX, ledY);
     }
 
-}
-
-int main()
-{
-    std::cout << "Starting program, looking for serial port..." << std::endl;
+    // Écrit les couleurs dans un buffer fourni par l'appelant, sans allocation.
+    // Retourne le nombre de couleurs écrites, ou -1 (pas d'image, erreur, buffer trop petit).
+    __declspec(dllexport)
+        int getScreenPixelsInto(int screenId, int ledX, int ledY, int keepPixels, float reduction, int* out, int capacity) {
+        if (!out || capacity < getLedCount(ledX, ledY)) return -1;
 
-    while (serialPort_mcu == INVALID_HANDLE_VALUE || serialPort_led == INVALID_HANDLE_VALUE) {
-        if (serialPort_mcu == INVALID_HANDLE_VALUE) {
-            serialPort_mcu = findSerial_mcu();
+        std::vector<int>* ledColors = captureScreen(screenId, ledX, ledY, keepPixels, reduction, SamplingFilter::Nearest);
+        if (!matchesLayout(ledColors, ledX, ledY) || ledColors->size() > static_cast<size_t>(capacity)) {
+            return -1;
         }
-        if (serialPort_led == INVALID_HANDLE_VALUE) {
-            serialPort_led = findSerial_led();
+
+        std::memcpy(out, ledColors->data(), ledColors->size() * sizeof(int));
+        return static_cast<int>(ledColors->size());
+    }
+
+    // Retourne un pointeur vers le double buffer de l'écran, valide jusqu'au prochain
+    // appel pour ce même écran (ne pas libérer). nullptr et *size = -1 en cas d'échec.
+    __declspec(dllexport)
+        const int* getScreenPixelsShared(int screenId, int ledX, int ledY, int keepPixels, float reduction, int* size) {
+        std::vector<int>* ledColors = captureScreen(screenId, ledX, ledY, keepPixels, reduction, SamplingFilter::Nearest);
+        if (!matchesLayout(ledColors, ledX, ledY)) {
+            if (size) *size = -1;
+            return nullptr;
         }
+
+        if (size) *size = static_cast<int>(ledColors->size());
+        return ledColors->data();
     }
 
-    screenController controller(serialPort_mcu);
+    __declspec(dllexport)
+        void freeMemory(int* ptr) {
+        delete[] ptr;
+    }
 
-    int ledX = 169;
-    int ledY = 90;
+}
 
-    const int TARGET_FPS = 60;
-    const std::chrono::microseconds FRAME_DURATION(1000000 / TARGET_FPS); // microseconds per frame
+int main()
+{
+    std::cout << "Starting program, looking for serial port..." << std::endl;
 
+    // Tous les ports sondés en parallèle, dernier port connu en premier ; la recherche
+    // continue en tâche de fond pour retrouver la bande après un rebranchement
+    serialDiscovery discovery;
+    serialPort_mcu = discovery.waitFor(SerialDevice::Mcu);
+    serialPort_led = discovery.waitFor(SerialDevice::Led);
+
+    // Profils du bureau (écran piloté, LEDs, couleurs), relus à chaque modification du
+    // fichier sans redémarrer ni perdre les ports série (voir deskConfig.cpp)
+    deskConfigWatcher configFile(besideExecutable("deskController.cfg"));
+    std::shared_ptr<const DeskConfig> config = configFile.current();
+    DeskProfile profile = *config->active();
+
+    // Sorties d'affichage suivies par WM_DISPLAYCHANGE, partagées avec le contrôleur
+    topologyCache displays;
+    screenController controller(serialPort_mcu, displays, profile.monitor);
+    std::shared_ptr<const TopologySnapshot> topology = displays.snapshot();
+
+    // Écrans capturés et ordre de la bande, décrits par le profil (sections [profil.screen]
+    // et lignes segment=, voir deskConfig.cpp) ; les écrans sont capturés en parallèle.
+    StripMapping mapping = profile.mapping();
+
+    // Sortie plafonnée (60 images/s par défaut), attente des images du bureau au lieu d'un sleep fixe
+    PacingConfig pacing;
+    pacing.maxFps = profile.maxFps;
+    framePacer pacer(pacing);
+
+    // Buffers réutilisés d'une image à l'autre (pas d'allocation dans la boucle)
+    std::vector<uint16_t> correctedPrecise;
+    std::vector<int> correctedColors;
+    std::vector<bool> pixelChanged;
+    std::vector<const int*> screenColors;
+    std::vector<int> screenSizes;
+    std::vector<int> stripColors;
+    changeDetector detector;
+    colorPipeline colorCorrection(profile.color);
+    // Écriture série dans son propre thread : la capture n'attend plus le port
+    // Recréés quand la bande est retrouvée sur un autre port
+    std::unique_ptr<win32SerialTransport> ledTransport(new win32SerialTransport(serialPort_led));
+    std::unique_ptr<ledWriter> writer(new ledWriter(*ledTransport));
+
+#ifdef LOG_STAGE_STATS
+    setStageStatsEnabled(true);
+#endif
 
     int frameCount = 0;
     int errorCount = 0;
+    int failedSeconds = 0;      // secondes consécutives sans écriture réussie sur la bande
     auto lastReportTime = std::chrono::steady_clock::now();
 
     while (true) {
-        if (controller.monitor_active) {
-
-            auto frameStart = std::chrono::steady_clock::now();
-
-            int keepPixels = 140;
-            float reduction = 1.0f;
-            //auto start = std::chrono::high_resolution_clock::now();
-            PixelResult result = getScreenPixels(2, ledX, ledY, keepPixels, reduction);
-            //auto end = std::chrono::high_resolution_clock::now();
-            //auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-            //std::cout << "Frame time taken: " << milliseconds << " milliseconds, size:" << result.size << std::endl;
-
-            if (result.size == -1) {
-                continue;
+        // Configuration rechargée : seul ce qui a changé est reconstruit
+        const std::shared_ptr<const DeskConfig> latestConfig = configFile.current();
+        if (latestConfig->version != config->version) {
+            const DeskProfile& next = *latestConfig->active();
+            if (!(next.monitor == profile.monitor)) {
+                controller.setMonitor(next.monitor);
             }
-
-            int offset = 460;           // décalage voulu
-            int total = result.size;    // nombre total de pixels
-
-            std::vector<int> correctedColors(total);
-            constexpr float gamma = 0.3f;             // plus gamma est grand, plus c'est sombre
-            constexpr float inv_gamma = 1.0f / gamma;
-            for (int i = 0; i < total; ++i) {
-                int raw = result.pixels[i];
-                float r = ((raw >> 16) & 0xFF) / 255.0f;
-                float g = ((raw >> 8) & 0xFF) / 255.0f;
-                float b = ((raw) & 0xFF) / 255.0f;
-                // correction gamma
-                uint8_t rc = uint8_t(std::pow(r, inv_gamma) * 255.0f + 0.5f);
-                uint8_t gc = uint8_t(std::pow(g, inv_gamma) * 255.0f + 0.5f);
-                uint8_t bc = uint8_t(std::pow(b, inv_gamma) * 255.0f + 0.5f);
-                correctedColors[i] = (rc << 16) | (gc << 8) | bc;
+            const StripMapping nextMapping = next.mapping();
+            if (!(nextMapping == mapping)) {
+                // La géométrie d'échantillonnage suit d'elle-même les nouveaux paramètres
+                mapping = nextMapping;
+                stripColors.clear(); // les LEDs d'un écran sans image repartent du noir
+                detector.reset();
             }
-
-            std::vector<bool> pixelChanged(total, false);
-            bool anyChange = false;
-            if (previousLedColors.size() != correctedColors.size()) {
-                // Premier frame ou changement de taille
-                previousLedColors.resize(correctedColors.size());
-                std::fill(pixelChanged.begin(), pixelChanged.end(), true);
-                anyChange = true;
+            if (next.stripOffset != profile.stripOffset) {
+                detector.reset(); // toute la bande est renvoyée à sa nouvelle place
             }
-            else {
-                // Détecter les changements
-                for (int j = 0; j < total; j++) {
-                    if (correctedColors[j] != previousLedColors[j]) {
-                        pixelChanged[j] = true;
-                        anyChange = true;
-                    }
-                }
+            colorCorrection.configure(next.color); // tables recalculées seulement si les couleurs changent
+            if (next.maxFps != profile.maxFps) {
+                pacing.maxFps = next.maxFps;
+                pacer.configure(pacing);
             }
-            // Copier pour la prochaine comparaison
-            std::copy(correctedColors.begin(), correctedColors.end(), previousLedColors.begin());
+            profile = next;
+            config = latestConfig;
+        }
 
-            //auto start = std::chrono::high_resolution_clock::now();
-            for (int j = 0; j < total; j++) {
-                if (!pixelChanged[j]) {
-                    continue;
-                }
-                int i = (offset + j) % total;
-                DWORD bytesWritten;
-                uint8_t buffer[6];
-                buffer[0] = (uint8_t)0xFF;
-                buffer[1] = (uint8_t)(i & 0xFF);
-                buffer[2] = (uint8_t)((i >> 8) & 0xFF);
-                int color = correctedColors[j];
-                buffer[3] = (uint8_t)((color >> 16) & 0xFF);
-                buffer[4] = (uint8_t)((color >> 8) & 0xFF);
-                buffer[5] = (uint8_t)(color & 0xFF);
-
-
-                if (buffer[1] == 0xFF) {
-                    buffer[1] = 0xFE;
-                }
-                if (buffer[2] == 0xFF) {
-                    buffer[2] = 0xFE;
-                }
-                if (buffer[3] == 0xFF) {
-                    buffer[3] = 0xFE;
-                }
-                if (buffer[4] == 0xFF) {
-                    buffer[4] = 0xFE;
-                }
-                if (buffer[5] == 0xFF) {
-                    buffer[5] = 0xFE;
-                }
-                if (!WriteFile(serialPort_led, buffer, 6, &bytesWritten, NULL)) {
-                    std::cerr << "[screen_capture] Failed to send pixel " << j << std::endl;
-                    errorCount++;
-                }
-                else if (bytesWritten != 6) {
-                    std::cerr << "[screen_capture] Partial send for pixel " << j
-                        << ", sent " << bytesWritten << " bytes" << std::endl;
-                    errorCount++;
-                }
-            }
-            DWORD bytesWritten2;
-            uint8_t data[5] = { 0xFF, 0xFF };
-            if (!WriteFile(serialPort_led, data, 2, &bytesWritten2, NULL)) {
-                std::cerr << "[screen_capture] Failed to sync pixel " << std::endl;
-                errorCount++;
-            }
-            if (!FlushFileBuffers(serialPort_led)) {
-                std::cerr << "[screen_capture] Warning: FlushFileBuffers failed (err="
-                    << GetLastError() << ")" << std::endl;
-                errorCount++;
+        // Microcontrôleur débranché : son port est rendu à la recherche, puis le canal est
+        // recréé sur le port retrouvé (les boutons servent aussi écran éteint)
+        if (serialPort_mcu != INVALID_HANDLE_VALUE && controller.mcuLost()) {
+            controller.disconnect();
+            CloseHandle(serialPort_mcu);
+            serialPort_mcu = INVALID_HANDLE_VALUE;
+            discovery.lost(SerialDevice::Mcu);
+        }
+        if (serialPort_mcu == INVALID_HANDLE_VALUE) {
+            serialPort_mcu = discovery.tryTake(SerialDevice::Mcu);
+            if (serialPort_mcu != INVALID_HANDLE_VALUE) {
+                controller.connect(serialPort_mcu);
             }
+        }
+
+        // Mode ou position changés : les écrans concernés sont réinitialisés avant la capture
+        const std::shared_ptr<const TopologySnapshot> latest = displays.snapshot();
+        if (latest->version != topology->version) {
+            syncScreensWithTopology(*latest);
+            topology = latest;
+        }
+
+        if (controller.monitorActive()) {
 
+            //auto start = std::chrono::high_resolution_clock::now();
+            // Bloque dans AcquireNextFrame jusqu'à une nouvelle image (délai allongé si les écrans sont figés)
+            for (const ScreenZones& zones : mapping.screens) {
+                setAcquireTimeout(zones.screenId, pacer.acquireTimeoutMs());
+            }
+            const auto captureStart = std::chrono::steady_clock::now();
+            captureScreens(mapping, screenColors, screenSizes);
+            // Un écran sans nouvelle couleur garde celles de l'image précédente dans la bande
+            const bool stitched = stitchStrip(mapping, screenColors.data(), screenSizes.data(), stripColors);
+            const int* pixels = stitched ? stripColors.data() : nullptr;
+            int total = static_cast<int>(stripColors.size()); // nombre total de LEDs de la bande
             //auto end = std::chrono::high_resolution_clock::now();
             //auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-            //saveToBMP(result.pixels, ledX, ledY, 600, 600, "test.bmp");
+            //std::cout << "Frame time taken: " << milliseconds << " milliseconds, size:" << total << std::endl;
+
+            const int offset = profile.stripOffset; // décalage voulu
+            if (pixels) {
+                // Gamma, balance des blancs et calibration par tables (virgule fixe 8.8 pour le tramage)
+                stageTimer colorTimer(Stage::ColorCorrection);
+                colorCorrection.apply(pixels, total, correctedPrecise);
+                colorTimer.stop();
+
+                // Seuil perceptuel + erreur cumulée : le bruit de l'image ne renvoie plus toute la bande
+                stageTimer deltaTimer(Stage::ChangeDetection);
+                bool anyChange = detector.update(correctedPrecise.data(), total, correctedColors, pixelChanged);
+                deltaTimer.stop();
+
+                // Encodage (trame ou ancien protocole selon USE_FRAMED_PROTOCOL) et envoi
+                // dans le thread d'écriture ; une image non encore partie est remplacée
+                if (anyChange && writer) {
+                    writer->publish(correctedColors, offset, captureStart);
+                }
 
-            // Clean up PixelResult
-            if (result.pixels) {
-                delete[] result.pixels;
+                frameCount++;
             }
 
-            frameCount++;
-            auto frameEnd = std::chrono::steady_clock::now();
-            auto frameTime = frameEnd - frameStart;
-            if (frameTime < FRAME_DURATION) {
-                std::this_thread::sleep_for(FRAME_DURATION - frameTime);
+            // Plafond de cadence : attente jusqu'à l'échéance avec le timer haute résolution
+            bool presented = false;
+            for (const ScreenZones& zones : mapping.screens) {
+                presented = presented || lastCapturePresented(zones.screenId);
             }
+            pacer.frameDone(presented);
+            pacer.waitNextFrame();
+
+            //auto end = std::chrono::high_resolution_clock::now();
+            //auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+            //saveToBMP(pixels, ledX, ledY, 600, 600, "test.bmp");
 
             auto currentTime = std::chrono::steady_clock::now();
             auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(currentTime - lastReportTime);
 
             if (elapsed.count() >= 1) {
-                std::cout << "[screen_capture] FPS: " << frameCount << " | Serial Errors: " << errorCount << std::endl;
+                int written = 0;
+                int dropped = 0;
+                if (writer) {
+                    errorCount += writer->takeErrors();
+                    written = writer->takeWritten();
+                    dropped = writer->takeDropped();
+                }
+                std::cout << "[screen_capture] FPS: " << frameCount << " | LED frames: " << written
+                    << " (dropped " << dropped << ") | Serial Errors: " << errorCount << std::endl;
+
+                // Bande débranchée : plus rien ne passe depuis quelques secondes, nouvelle recherche
+                failedSeconds = (errorCount > 0 && written == 0) ? failedSeconds + 1 : 0;
+                if (writer && failedSeconds >= 3) {
+                    writer.reset();
+                    ledTransport.reset();
+                    CloseHandle(serialPort_led);
+                    serialPort_led = INVALID_HANDLE_VALUE;
+                    discovery.lost(SerialDevice::Led);
+                }
+                if (!writer) {
+                    serialPort_led = discovery.tryTake(SerialDevice::Led);
+                    if (serialPort_led != INVALID_HANDLE_VALUE) {
+                        ledTransport.reset(new win32SerialTransport(serialPort_led));
+                        writer.reset(new ledWriter(*ledTransport));
+                        // La bande rebranchée est éteinte : la renvoyer en entier, même si
+                        // l'écran est figé et qu'aucune image ne change
+                        detector.reset();
+                        if (!correctedColors.empty()) {
+                            writer->publish(correctedColors, profile.stripOffset);
+                        }
+                        failedSeconds = 0;
+                    }
+                }
+#ifdef LOG_STAGE_STATS
+                logStageStats(std::cout);
+#endif
                 frameCount = 0;
                 errorCount = 0;
                 lastReportTime = currentTime;
             }
         }
         else {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+            // Réveil dès que l'écran est rallumé ; le délai couvre un WM_DISPLAYCHANGE manqué
+            displays.waitForChange(topology->version, 5000);
         }
     }
 
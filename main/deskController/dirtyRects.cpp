@@ -0,0 +1,53 @@
+﻿#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Intersection des rectangles modifiés d'une image (dirty rects / destinations des
+// move rects fournis par DXGI) avec les zones de LED. Indépendant de l'OS : on peut
+// l'alimenter avec des listes de rectangles synthétiques.
+
+// Rectangle en pixels source, bornes droite et basse exclues (comme RECT)
+struct FrameRect {
+    int32_t left, top, right, bottom;
+};
+
+// Région source [left, right) x [top, bottom) réellement lue pour une zone
+inline FrameRect zoneSourceRect(const SamplingLayout& layout, const ZoneInfo& zone) {
+    FrameRect rect = { 0, 0, 0, 0 };
+    if (zone.startX >= zone.endX || zone.startY >= zone.endY) return rect;
+
+    rect.left = static_cast<int32_t>(layout.srcXOffset[zone.startX] / 4);
+    rect.right = static_cast<int32_t>(layout.srcXOffset[zone.endX - 1] / 4) + 1;
+    rect.top = static_cast<int32_t>(layout.srcRow[zone.startY]);
+    rect.bottom = static_cast<int32_t>(layout.srcRow[zone.endY - 1]) + 1;
+    return rect;
+}
+
+inline bool rectsIntersect(const FrameRect& a, const FrameRect& b) {
+    return a.left < b.right && b.left < a.right && a.top < b.bottom && b.top < a.bottom;
+}
+
+// Marque dans dirty (une entrée par zone) les zones touchées par au moins un rectangle.
+// Retourne le nombre de zones marquées.
+inline size_t markDirtyZones(const SamplingLayout& layout, const FrameRect* rects, size_t rectCount,
+    std::vector<uint8_t>& dirty) {
+    dirty.assign(layout.zones.size(), 0);
+    if (!layout.valid || rectCount == 0) return 0;
+
+    size_t marked = 0;
+    for (size_t i = 0; i < layout.zones.size(); ++i) {
+        if (layout.zonePixels[i] == 0) continue;
+        const FrameRect zoneRect = zoneSourceRect(layout, layout.zones[i]);
+
+        for (size_t r = 0; r < rectCount; ++r) {
+            // Boîte englobante des pixels lus : un rectangle tombé entre deux colonnes
+            // sous-échantillonnées marque la zone par excès, jamais par défaut
+            if (rectsIntersect(zoneRect, rects[r])) {
+                dirty[i] = 1;
+                ++marked;
+                break;
+            }
+        }
+    }
+    return marked;
+}
@@ -0,0 +1,359 @@
+﻿#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <atomic>
+#include <chrono>
+#include <codecvt>
+#include <condition_variable>
+#include <functional>
+#include <fstream>
+#include <iostream>
+#include <locale>
+#include <memory>
+#include <mutex>
+#include <thread>
+#endif
+
+// État et mode de l'écran piloté par les boutons du bureau. Le chemin normal interroge
+// et applique la topologie d'affichage dans le processus (EnumDisplayDevices,
+// ChangeDisplaySettingsEx) : quelques microsecondes, aucun fichier. MultiMonitorTool.exe
+// et son rapport texte ne servent plus que de secours.
+
+// Écran piloté et mode appliqué à l'allumage
+struct MonitorMode {
+    std::string deviceName = "\\\\.\\DISPLAY3";
+    int width = 3840;
+    int height = 2160;
+    int frequency = 120;
+    int positionX = 633;
+    int positionY = -3760;
+    int scalePercent = 150; // mise à l'échelle : Windows la garde par écran, seul le secours la réapplique
+
+    bool operator==(const MonitorMode& other) const {
+        return deviceName == other.deviceName && width == other.width && height == other.height && frequency == other.frequency
+            && positionX == other.positionX && positionY == other.positionY && scalePercent == other.scalePercent;
+    }
+};
+
+// Rapport texte de MultiMonitorTool (/stext), converti en UTF-8 : un bloc par écran, les
+// lignes « clé : valeur » avec « Active » avant « Name ». Retourne true si deviceName
+// figure dans le rapport ; active reçoit alors son champ Active. Fonction pure.
+inline bool parseMonitorReport(const std::string& report, const std::string& deviceName, bool& active) {
+    std::istringstream lines(report);
+    std::string line;
+    bool blockActive = false;
+    while (std::getline(lines, line)) {
+        const size_t separator = line.find(':');
+        if (separator == std::string::npos) {
+            // Ligne de séparation entre deux écrans
+            blockActive = false;
+            continue;
+        }
+
+        std::string key = line.substr(0, separator);
+        key.erase(0, key.find_first_not_of(" \t"));
+        key.erase(key.find_last_not_of(" \t") + 1);
+        std::string value = line.substr(separator + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        value.erase(value.find_last_not_of(" \t\r\n") + 1);
+
+        if (key == "Active") {
+            blockActive = value == "Yes";
+        }
+        else if (key == "Name" && value == deviceName) {
+            active = blockActive;
+            return true;
+        }
+    }
+    return false;
+}
+
+// État d'une sortie d'affichage (\\.\DISPLAYn)
+struct OutputState {
+    std::string deviceName;
+    bool active = false; // attachée au bureau ; le mode n'est renseigné que dans ce cas
+    int width = 0;
+    int height = 0;
+    int frequency = 0;
+    int positionX = 0;
+    int positionY = 0;
+
+    bool operator==(const OutputState& other) const {
+        return deviceName == other.deviceName && active == other.active && width == other.width && height == other.height
+            && frequency == other.frequency && positionX == other.positionX && positionY == other.positionY;
+    }
+};
+
+// Topologie complète à un instant donné ; version augmente à chaque changement
+struct TopologySnapshot {
+    uint64_t version = 0;
+    std::vector<OutputState> outputs;
+
+    const OutputState* find(const std::string& deviceName) const {
+        for (const OutputState& output : outputs) {
+            if (output.deviceName == deviceName) return &output;
+        }
+        return nullptr;
+    }
+};
+
+#ifdef _WIN32
+
+class displayTopology {
+
+public:
+    virtual ~displayTopology() {}
+
+    // false si l'état n'a pas pu être déterminé
+    virtual bool queryActive(const MonitorMode& monitor, bool& active) = 0;
+    virtual bool enable(const MonitorMode& monitor) = 0;
+    virtual bool disable(const MonitorMode& monitor) = 0;
+};
+
+// Topologie interrogée et modifiée dans le processus
+class win32DisplayTopology : public displayTopology {
+
+private:
+    // Enregistre le mode de l'écran sans l'appliquer, puis applique tous les changements
+    static bool applyMode(const MonitorMode& monitor, DEVMODEA& mode) {
+        mode.dmSize = sizeof(mode);
+        const LONG staged = ChangeDisplaySettingsExA(monitor.deviceName.c_str(), &mode, NULL,
+            CDS_UPDATEREGISTRY | CDS_NORESET, NULL);
+        if (staged != DISP_CHANGE_SUCCESSFUL) return false;
+        return ChangeDisplaySettingsExA(NULL, NULL, NULL, 0, NULL) == DISP_CHANGE_SUCCESSFUL;
+    }
+
+public:
+    // Toutes les sorties, avec le mode courant de celles qui sont actives
+    static void enumerate(std::vector<OutputState>& outputs) {
+        outputs.clear();
+        DISPLAY_DEVICEA device = {};
+        device.cb = sizeof(device);
+        for (DWORD i = 0; EnumDisplayDevicesA(NULL, i, &device, 0); ++i) {
+            OutputState output;
+            output.deviceName = device.DeviceName;
+            output.active = (device.StateFlags & DISPLAY_DEVICE_ATTACHED_TO_DESKTOP) != 0;
+
+            DEVMODEA mode = {};
+            mode.dmSize = sizeof(mode);
+            if (output.active && EnumDisplaySettingsExA(device.DeviceName, ENUM_CURRENT_SETTINGS, &mode, 0)) {
+                output.width = static_cast<int>(mode.dmPelsWidth);
+                output.height = static_cast<int>(mode.dmPelsHeight);
+                output.frequency = static_cast<int>(mode.dmDisplayFrequency);
+                output.positionX = mode.dmPosition.x;
+                output.positionY = mode.dmPosition.y;
+            }
+            outputs.push_back(output);
+            device.cb = sizeof(device);
+        }
+    }
+
+    bool queryActive(const MonitorMode& monitor, bool& active) override {
+        DISPLAY_DEVICEA device = {};
+        device.cb = sizeof(device);
+        for (DWORD i = 0; EnumDisplayDevicesA(NULL, i, &device, 0); ++i) {
+            if (monitor.deviceName == device.DeviceName) {
+                active = (device.StateFlags & DISPLAY_DEVICE_ATTACHED_TO_DESKTOP) != 0;
+                return true;
+            }
+            device.cb = sizeof(device);
+        }
+        return false;
+    }
+
+    bool enable(const MonitorMode& monitor) override {
+        DEVMODEA mode = {};
+        mode.dmFields = DM_POSITION | DM_PELSWIDTH | DM_PELSHEIGHT | DM_DISPLAYFREQUENCY;
+        mode.dmPosition.x = monitor.positionX;
+        mode.dmPosition.y = monitor.positionY;
+        mode.dmPelsWidth = static_cast<DWORD>(monitor.width);
+        mode.dmPelsHeight = static_cast<DWORD>(monitor.height);
+        mode.dmDisplayFrequency = static_cast<DWORD>(monitor.frequency);
+        return applyMode(monitor, mode);
+    }
+
+    // Une taille nulle détache l'écran du bureau
+    bool disable(const MonitorMode& monitor) override {
+        DEVMODEA mode = {};
+        mode.dmFields = DM_POSITION | DM_PELSWIDTH | DM_PELSHEIGHT;
+        return applyMode(monitor, mode);
+    }
+};
+
+// Ancien chemin : MultiMonitorTool.exe, rapport écrit sur disque en UTF-16
+class multiMonitorToolTopology : public displayTopology {
+
+private:
+    const std::string MONITORS_FILE = "monitors.txt";
+    const std::string MULTIMONITOR_TOOL_PATH = "MultiMonitorTool.exe";
+
+    bool run(const std::string& arguments) {
+        const std::string cmd = MULTIMONITOR_TOOL_PATH + " " + arguments;
+        return system(cmd.c_str()) == 0;
+    }
+
+public:
+    bool queryActive(const MonitorMode& monitor, bool& active) override {
+        try {
+            run("/stext " + MONITORS_FILE);
+
+            // Lecture correcte du fichier en UTF-16 avec gestion du BOM
+            std::wifstream wifs(MONITORS_FILE, std::ios::binary);
+            if (!wifs) {
+                throw std::runtime_error("Impossible d'ouvrir monitors.txt");
+            }
+
+            // Gérer le BOM UTF-16 si présent
+            wifs.imbue(std::locale(wifs.getloc(),
+                new std::codecvt_utf16<wchar_t, 0x10ffff, std::consume_header>));
+
+            std::wstringstream wss;
+            wss << wifs.rdbuf();
+            std::wstring wContent = wss.str();
+
+            // Conversion UTF-16 -> UTF-8
+            int utf8Size = WideCharToMultiByte(CP_UTF8, 0, wContent.c_str(), -1, NULL, 0, NULL, NULL);
+            std::string content(utf8Size - 1, '\0');
+            WideCharToMultiByte(CP_UTF8, 0, wContent.c_str(), -1, &content[0], utf8Size, NULL, NULL);
+
+            return parseMonitorReport(content, monitor.deviceName, active);
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return false;
+        }
+    }
+
+    bool enable(const MonitorMode& monitor) override {
+        std::ostringstream arguments;
+        arguments << "/enable \"" << monitor.deviceName << "\" /SetMonitors \"Name=" << monitor.deviceName
+            << " Width=" << monitor.width << " Height=" << monitor.height << " DisplayFrequency=" << monitor.frequency
+            << " PositionX=" << monitor.positionX << " PositionY=" << monitor.positionY
+            << "\" /SetScale \"" << monitor.deviceName << "\" " << monitor.scalePercent;
+        return run(arguments.str());
+    }
+
+    bool disable(const MonitorMode& monitor) override {
+        return run("/disable \"" + monitor.deviceName + "\"");
+    }
+};
+
+// Topologie tenue à jour par les événements WM_DISPLAYCHANGE (fenêtre cachée sur son
+// propre thread) au lieu d'être relue à chaque question. snapshot() ne prend aucun verrou ;
+// waitForChange() réveille les threads qui attendent un changement (écran rallumé,
+// nouveau mode) dès qu'il arrive.
+class topologyCache {
+
+private:
+    std::shared_ptr<const TopologySnapshot> current;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::thread windowThread;
+    HWND window = NULL;
+    bool windowReady = false;
+
+    static LRESULT CALLBACK windowProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam) {
+        if (message == WM_DISPLAYCHANGE) {
+            topologyCache* self = reinterpret_cast<topologyCache*>(GetWindowLongPtrA(hwnd, GWLP_USERDATA));
+            if (self) {
+                self->refresh();
+            }
+            return 0;
+        }
+        if (message == WM_DESTROY) {
+            PostQuitMessage(0);
+            return 0;
+        }
+        return DefWindowProcA(hwnd, message, wParam, lParam);
+    }
+
+    void run() {
+        const char* className = "deskControllerTopology";
+        WNDCLASSEXA windowClass = {};
+        windowClass.cbSize = sizeof(windowClass);
+        windowClass.lpfnWndProc = &topologyCache::windowProc;
+        windowClass.hInstance = GetModuleHandleA(NULL);
+        windowClass.lpszClassName = className;
+        RegisterClassExA(&windowClass);
+
+        // Fenêtre de premier niveau jamais affichée : les fenêtres « message only » ne
+        // reçoivent pas WM_DISPLAYCHANGE
+        HWND created = CreateWindowExA(0, className, "", 0, 0, 0, 0, 0, NULL, NULL, windowClass.hInstance, NULL);
+        if (created) {
+            SetWindowLongPtrA(created, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this));
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            window = created;
+            windowReady = true;
+        }
+        changed.notify_all();
+        if (!created) {
+            std::cerr << "Topologie : pas de fenêtre, les changements d'écran ne seront pas suivis" << std::endl;
+            return;
+        }
+
+        MSG message;
+        while (GetMessageA(&message, NULL, 0, 0) > 0) {
+            TranslateMessage(&message);
+            DispatchMessageA(&message);
+        }
+        UnregisterClassA(className, windowClass.hInstance);
+    }
+
+public:
+    topologyCache() {
+        refresh();
+        windowThread = std::thread(&topologyCache::run, this);
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return windowReady; });
+    }
+
+    ~topologyCache() {
+        HWND target;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            target = window;
+        }
+        if (target) {
+            PostMessageA(target, WM_CLOSE, 0, 0);
+        }
+        if (windowThread.joinable()) {
+            windowThread.join();
+        }
+    }
+
+    topologyCache(const topologyCache&) = delete;
+    topologyCache& operator=(const topologyCache&) = delete;
+
+    std::shared_ptr<const TopologySnapshot> snapshot() const {
+        return std::atomic_load(&current);
+    }
+
+    // Relit la topologie ; publie une nouvelle version seulement si quelque chose a changé
+    void refresh() {
+        // Sous le verrou : deux relectures concurrentes ne publient pas dans le désordre
+        std::lock_guard<std::mutex> lock(mutex);
+        std::shared_ptr<TopologySnapshot> next = std::make_shared<TopologySnapshot>();
+        win32DisplayTopology::enumerate(next->outputs);
+        const std::shared_ptr<const TopologySnapshot> previous = std::atomic_load(&current);
+        if (previous && previous->outputs == next->outputs) return;
+        next->version = previous ? previous->version + 1 : 1;
+        std::atomic_store(&current, std::shared_ptr<const TopologySnapshot>(next));
+        changed.notify_all();
+    }
+
+    // Attend une version plus récente que seenVersion, au plus timeoutMs
+    std::shared_ptr<const TopologySnapshot> waitForChange(uint64_t seenVersion, int timeoutMs) {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&] {
+            return std::atomic_load(&current)->version != seenVersion;
+        });
+        return std::atomic_load(&current);
+    }
+};
+
+#endif
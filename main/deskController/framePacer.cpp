@@ -0,0 +1,128 @@
+﻿#include <chrono>
+#include <thread>
+
+#if defined(_WIN32) && !defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// Rythme de la boucle de capture. Au lieu d'un sleep fixe après chaque image (et d'une
+// boucle active quand AcquireNextFrame expire), la capture attend une nouvelle image du
+// bureau avec un délai fourni ici, la sortie est plafonnée à maxFps, et l'attente
+// s'allonge quand l'écran reste figé. Les échéances utilisent un timer haute résolution
+// (waitable timer sous Windows) plutôt que la granularité de sleep_for.
+
+struct PacingConfig {
+    int maxFps = 60;            // plafond d'images traitées par seconde
+    int idleAfterFrames = 30;   // images sans mise à jour du bureau avant de ralentir
+    int maxIdleTimeoutMs = 250; // attente maximale d'une image quand l'écran est figé
+};
+
+// Attente jusqu'à une échéance précise
+class precisionTimer {
+
+private:
+#ifdef _WIN32
+    HANDLE timer = NULL;
+#endif
+
+public:
+    precisionTimer() {
+#ifdef _WIN32
+        // Timer haute résolution (Windows 10 1803+), sinon timer classique
+        timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        if (!timer) {
+            timer = CreateWaitableTimerW(NULL, FALSE, NULL);
+        }
+#endif
+    }
+
+    ~precisionTimer() {
+#ifdef _WIN32
+        if (timer) {
+            CloseHandle(timer);
+        }
+#endif
+    }
+
+    precisionTimer(const precisionTimer&) = delete;
+    precisionTimer& operator=(const precisionTimer&) = delete;
+
+    void sleepUntil(std::chrono::steady_clock::time_point deadline) {
+        const auto remaining = deadline - std::chrono::steady_clock::now();
+        if (remaining <= std::chrono::steady_clock::duration::zero()) return;
+#ifdef _WIN32
+        if (timer) {
+            // Délai relatif (négatif) en unités de 100 ns
+            LARGE_INTEGER due;
+            due.QuadPart = -static_cast<LONGLONG>(std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count() / 100);
+            if (due.QuadPart == 0) return;
+            if (SetWaitableTimer(timer, &due, 0, NULL, NULL, FALSE)) {
+                WaitForSingleObject(timer, INFINITE);
+                return;
+            }
+        }
+#endif
+        std::this_thread::sleep_until(deadline);
+    }
+};
+
+class framePacer {
+
+private:
+    PacingConfig config;
+    std::chrono::steady_clock::duration frameInterval;
+    std::chrono::steady_clock::time_point nextDeadline;
+    int staticFrames = 0;
+    precisionTimer timer;
+
+public:
+    framePacer(const PacingConfig& pacing = PacingConfig()) {
+        configure(pacing);
+        nextDeadline = std::chrono::steady_clock::now();
+    }
+
+    void configure(const PacingConfig& pacing) {
+        config = pacing;
+        if (config.maxFps <= 0) config.maxFps = 1;
+        frameInterval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::microseconds(1000000 / config.maxFps));
+    }
+
+    // Délai d'attente d'une nouvelle image pour la prochaine capture : une période quand le
+    // bureau bouge, puis doublé par palier de idleAfterFrames images figées
+    unsigned acquireTimeoutMs() const {
+        unsigned timeout = static_cast<unsigned>(1000 / config.maxFps);
+        if (timeout == 0) timeout = 1;
+        if (staticFrames >= config.idleAfterFrames && config.idleAfterFrames > 0) {
+            const int steps = staticFrames / config.idleAfterFrames;
+            for (int i = 0; i < steps && timeout < static_cast<unsigned>(config.maxIdleTimeoutMs); ++i) {
+                timeout *= 2;
+            }
+        }
+        if (timeout > static_cast<unsigned>(config.maxIdleTimeoutMs)) {
+            timeout = static_cast<unsigned>(config.maxIdleTimeoutMs);
+        }
+        return timeout;
+    }
+
+    // Fin d'une itération. updated : le bureau a présenté une nouvelle image
+    void frameDone(bool updated) {
+        if (updated) {
+            staticFrames = 0;
+        }
+        else if (staticFrames < 0x7FFFFFFF) {
+            ++staticFrames;
+        }
+    }
+
+    // Attend l'échéance de l'image suivante (plafond maxFps). En retard de plus d'une
+    // période, l'échéance est recalée au lieu d'enchaîner des images pour rattraper.
+    void waitNextFrame() {
+        const auto now = std::chrono::steady_clock::now();
+        if (nextDeadline + frameInterval < now) {
+            nextDeadline = now;
+        }
+        timer.sleepUntil(nextDeadline);
+        nextDeadline += frameInterval;
+    }
+};
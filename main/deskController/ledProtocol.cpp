@@ -0,0 +1,267 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Protocole tramé vers la bande de LEDs : une image entière part en un seul WriteFile
+// au lieu d'un enregistrement de 6 octets (0xFF, index, RGB) par LED.
+//
+// Trame avant encodage :
+//   [type = LED_FRAME_TYPE] [flags] puis des enregistrements
+//   [start u16 LE] [count u16 LE] [R G B] * count
+//   et enfin [crc16 u16 LE] (CRC-16/CCITT-FALSE sur tout ce qui précède)
+// La trame est encodée en COBS puis terminée par 0x00 : aucun octet de la charge utile
+// n'est plus réservé, les couleurs gardent toute la plage 0-255 (plus de clamp à 0xFE).
+
+const uint8_t LED_FRAME_TYPE = 0x4C;     // 'L'
+const uint8_t LED_FRAME_FLAG_SHOW = 0x01; // afficher après application des enregistrements
+
+inline uint16_t crc16Ccitt(const uint8_t* data, size_t size) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < size; ++i) {
+        crc ^= static_cast<uint16_t>(data[i]) << 8;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+        }
+    }
+    return crc;
+}
+
+// Encodage COBS de data dans out (ajouté à la suite), sans le délimiteur final
+inline void cobsEncode(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    size_t codeIndex = out.size();
+    out.push_back(0);
+    uint8_t code = 1;
+
+    for (size_t i = 0; i < size; ++i) {
+        if (data[i] == 0) {
+            out[codeIndex] = code;
+            codeIndex = out.size();
+            out.push_back(0);
+            code = 1;
+            continue;
+        }
+        out.push_back(data[i]);
+        if (++code == 0xFF) {
+            out[codeIndex] = code;
+            codeIndex = out.size();
+            out.push_back(0);
+            code = 1;
+        }
+    }
+    out[codeIndex] = code;
+}
+
+// Décodage COBS (sans le délimiteur). Retourne false si l'encodage est invalide.
+// Référence pour le firmware et pour les tests hors machine.
+inline bool cobsDecode(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    out.clear();
+    size_t i = 0;
+    while (i < size) {
+        const uint8_t code = data[i++];
+        if (code == 0) return false;
+        for (uint8_t k = 1; k < code; ++k) {
+            if (i >= size || data[i] == 0) return false;
+            out.push_back(data[i++]);
+        }
+        if (code != 0xFF && i < size) {
+            out.push_back(0);
+        }
+    }
+    return true;
+}
+
+class ledFrameEncoder {
+
+private:
+    std::vector<uint8_t> raw;     // trame en clair
+    std::vector<uint8_t> encoded; // trame COBS + délimiteur, prête à écrire
+    size_t recordCount = 0;
+
+public:
+    void begin(bool show) {
+        raw.clear();
+        recordCount = 0;
+        raw.push_back(LED_FRAME_TYPE);
+        raw.push_back(show ? LED_FRAME_FLAG_SHOW : 0);
+    }
+
+    // Ajoute count LEDs consécutives à partir de l'index physique start (couleurs 0x00RRGGBB)
+    void addSpan(uint16_t start, const int* colors, uint16_t count) {
+        raw.push_back(static_cast<uint8_t>(start & 0xFF));
+        raw.push_back(static_cast<uint8_t>(start >> 8));
+        raw.push_back(static_cast<uint8_t>(count & 0xFF));
+        raw.push_back(static_cast<uint8_t>(count >> 8));
+        for (uint16_t i = 0; i < count; ++i) {
+            const int color = colors[i];
+            raw.push_back(static_cast<uint8_t>((color >> 16) & 0xFF));
+            raw.push_back(static_cast<uint8_t>((color >> 8) & 0xFF));
+            raw.push_back(static_cast<uint8_t>(color & 0xFF));
+        }
+        ++recordCount;
+    }
+
+    size_t spans() const {
+        return recordCount;
+    }
+
+    // Termine la trame (CRC, COBS, délimiteur) et retourne les octets à envoyer
+    const std::vector<uint8_t>& finish() {
+        const uint16_t crc = crc16Ccitt(raw.data(), raw.size());
+        raw.push_back(static_cast<uint8_t>(crc & 0xFF));
+        raw.push_back(static_cast<uint8_t>(crc >> 8));
+
+        encoded.clear();
+        cobsEncode(raw.data(), raw.size(), encoded);
+        encoded.push_back(0x00);
+        return encoded;
+    }
+};
+
+// Décode une trame (sans le délimiteur) et vérifie son CRC. Référence du côté firmware :
+// onSpan(start, rgb, count) est appelé pour chaque enregistrement.
+template <typename OnSpan>
+bool decodeLedFrame(const uint8_t* data, size_t size, bool& show, OnSpan onSpan) {
+    std::vector<uint8_t> raw;
+    if (!cobsDecode(data, size, raw) || raw.size() < 4) return false;
+
+    const size_t payloadSize = raw.size() - 2;
+    const uint16_t crc = static_cast<uint16_t>(raw[payloadSize] | (raw[payloadSize + 1] << 8));
+    if (crc16Ccitt(raw.data(), payloadSize) != crc || raw[0] != LED_FRAME_TYPE) return false;
+
+    show = (raw[1] & LED_FRAME_FLAG_SHOW) != 0;
+    size_t pos = 2;
+    while (pos < payloadSize) {
+        if (pos + 4 > payloadSize) return false;
+        const uint16_t start = static_cast<uint16_t>(raw[pos] | (raw[pos + 1] << 8));
+        const uint16_t count = static_cast<uint16_t>(raw[pos + 2] | (raw[pos + 3] << 8));
+        pos += 4;
+        if (pos + static_cast<size_t>(count) * 3 > payloadSize) return false;
+        onSpan(start, raw.data() + pos, count);
+        pos += static_cast<size_t>(count) * 3;
+    }
+    return true;
+}
+
+// Encodage delta d'une image : les LEDs modifiées adjacentes sont regroupées en spans
+// (start, count, couleurs), et l'image complète est envoyée à la place dès qu'elle
+// coûte moins d'octets. À 4 Mbaud la liaison série est le vrai plafond : chaque
+// octet économisé est du FPS en plus.
+class ledDeltaEncoder {
+
+private:
+    struct LedSpan {
+        int first;  // index logique (ordre de l'échantillonnage) de la première LED
+        int count;
+    };
+
+    static const size_t SPAN_HEADER_BYTES = 4; // start u16 + count u16
+    static const size_t LED_BYTES = 3;
+
+    ledFrameEncoder encoder;
+    std::vector<LedSpan> spans;
+    bool lastFull = false;
+
+    // Nombre d'octets de trame (avant CRC et COBS) pour une liste de spans
+    static size_t payloadSize(size_t spanCount, size_t ledCount) {
+        return 2 + spanCount * SPAN_HEADER_BYTES + ledCount * LED_BYTES;
+    }
+
+    // Ajoute [first, first + count) en coupant au retour à l'index physique 0
+    void addSpans(const int* colors, int first, int count, int total, int offset) {
+        while (count > 0) {
+            const int start = (offset + first) % total;
+            int run = total - start;
+            if (run > count) run = count;
+            encoder.addSpan(static_cast<uint16_t>(start), colors + first, static_cast<uint16_t>(run));
+            first += run;
+            count -= run;
+        }
+    }
+
+public:
+    // Construit la trame pour les LEDs marquées dans changed. colors est dans l'ordre
+    // logique ; la LED logique j est la LED physique (offset + j) % total.
+    // Retourne nullptr si rien n'a changé.
+    const std::vector<uint8_t>* encode(const int* colors, const std::vector<bool>& changed, int total, int offset) {
+        spans.clear();
+        if (total <= 0 || total > 0xFFFF) return nullptr;
+        offset = ((offset % total) + total) % total;
+
+        // Regrouper les LEDs modifiées. Un trou plus court qu'un en-tête de span coûte
+        // moins cher à renvoyer tel quel qu'à ouvrir un nouveau span.
+        const int maxGap = static_cast<int>(SPAN_HEADER_BYTES / LED_BYTES);
+        size_t sentLeds = 0;
+        for (int j = 0; j < total; ++j) {
+            if (!changed[j]) continue;
+            if (!spans.empty()) {
+                LedSpan& last = spans.back();
+                const int gap = j - (last.first + last.count);
+                if (gap <= maxGap) {
+                    sentLeds += gap + 1;
+                    last.count += gap + 1;
+                    continue;
+                }
+            }
+            spans.push_back({ j, 1 });
+            ++sentLeds;
+        }
+        if (spans.empty()) return nullptr;
+
+        // Un span qui passe par l'index physique 0 part en deux enregistrements
+        const int wrap = (total - offset) % total; // LED logique de l'index physique 0
+        size_t deltaSpans = spans.size();
+        for (const LedSpan& span : spans) {
+            if (wrap > span.first && wrap < span.first + span.count) ++deltaSpans;
+        }
+
+        // Image complète : un span (deux si le décalage coupe la bande)
+        const size_t fullSpans = offset == 0 ? 1 : 2;
+        const size_t deltaBytes = payloadSize(deltaSpans, sentLeds);
+        const size_t fullBytes = payloadSize(fullSpans, static_cast<size_t>(total));
+        lastFull = fullBytes <= deltaBytes;
+
+        encoder.begin(true);
+        if (lastFull) {
+            addSpans(colors, 0, total, total, offset);
+        }
+        else {
+            for (const LedSpan& span : spans) {
+                addSpans(colors, span.first, span.count, total, offset);
+            }
+        }
+        return &encoder.finish();
+    }
+
+    // La dernière trame contenait-elle toute la bande ?
+    bool wasFullFrame() const {
+        return lastFull;
+    }
+
+    size_t spanCount() const {
+        return encoder.spans();
+    }
+};
+
+// Ancien protocole (firmware non tramé) : un enregistrement 0xFF, index, R, G, B par
+// LED modifiée puis la synchro 0xFF 0xFF. 0xFF étant réservé, les octets sont bornés à 0xFE.
+inline void encodeLegacyFrame(const int* colors, const std::vector<bool>& changed, int total, int offset,
+    std::vector<uint8_t>& out) {
+    out.clear();
+    auto clamp = [](int value) -> uint8_t {
+        return static_cast<uint8_t>(value == 0xFF ? 0xFE : value);
+    };
+    for (int j = 0; j < total; j++) {
+        if (!changed[j]) continue;
+        const int i = (offset + j) % total;
+        const int color = colors[j];
+        out.push_back(0xFF);
+        out.push_back(clamp(i & 0xFF));
+        out.push_back(clamp((i >> 8) & 0xFF));
+        out.push_back(clamp((color >> 16) & 0xFF));
+        out.push_back(clamp((color >> 8) & 0xFF));
+        out.push_back(clamp(color & 0xFF));
+    }
+    out.push_back(0xFF);
+    out.push_back(0xFF);
+}
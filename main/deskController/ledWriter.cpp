@@ -0,0 +1,182 @@
+﻿#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "serialTransport.cpp"
+#include "ledProtocol.cpp"
+#include "stageStats.cpp"
+
+// Étage de sortie vers la bande : la boucle de capture publie l'état des LEDs dans un
+// emplacement sans verrou (un producteur, un consommateur, la dernière image gagne)
+// et un thread dédié l'encode et l'écrit. La latence du port série ne retarde plus
+// la capture suivante ; une image pas encore partie est simplement remplacée.
+//
+// L'emplacement contient l'état complet de la bande et non un delta : le thread
+// d'écriture compare avec ce qu'il a réellement envoyé, donc une image abandonnée
+// ne perd aucune modification. Indépendant de l'OS (voir byteTransport).
+
+class ledWriter {
+
+private:
+    struct LedFrame {
+        std::vector<int> colors; // couleurs affichées, ordre logique
+        int offset = 0;          // LED logique j -> LED physique (offset + j) % total
+        std::chrono::steady_clock::time_point captured; // début de la capture (latence de bout en bout)
+    };
+
+    static const uint8_t FRESH = 0x4; // l'image du milieu n'a pas encore été prise
+
+    // Triple tampon : le producteur écrit dans frames[backIndex], le consommateur lit
+    // frames[frontIndex], et les deux échangent leur tampon avec celui du milieu.
+    LedFrame frames[3];
+    int backIndex = 0;
+    int frontIndex = 1;
+    std::atomic<uint8_t> middle{ 2 };
+
+    byteTransport& transport;
+    std::thread writerThread;
+    std::atomic<bool> running{ true };
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+
+    std::atomic<bool> resyncRequested{ true };
+    std::atomic<int> errorCount{ 0 };
+    std::atomic<int> droppedCount{ 0 };
+    std::atomic<int> frameCount{ 0 };
+
+    // État du thread d'écriture
+    std::vector<int> lastWritten;
+    std::vector<bool> changed;
+#ifdef USE_FRAMED_PROTOCOL
+    ledDeltaEncoder encoder;
+#else
+    std::vector<uint8_t> legacyBytes;
+#endif
+
+    bool takeFrame() {
+        if (!(middle.load(std::memory_order_acquire) & FRESH)) return false;
+        const uint8_t previous = middle.exchange(static_cast<uint8_t>(frontIndex), std::memory_order_acq_rel);
+        frontIndex = previous & 0x3;
+        return true;
+    }
+
+    void writeFrame(const LedFrame& frame) {
+        const int total = static_cast<int>(frame.colors.size());
+        if (total == 0) return;
+
+        const bool full = resyncRequested.exchange(false) || lastWritten.size() != frame.colors.size();
+        changed.assign(total, full);
+        bool anyChange = full;
+        if (!full) {
+            for (int j = 0; j < total; ++j) {
+                if (frame.colors[j] != lastWritten[j]) {
+                    changed[j] = true;
+                    anyChange = true;
+                }
+            }
+        }
+        if (!anyChange) return;
+
+        stageTimer encodeTimer(Stage::Encode);
+#ifdef USE_FRAMED_PROTOCOL
+        const std::vector<uint8_t>* bytes = encoder.encode(frame.colors.data(), changed, total, frame.offset);
+        if (!bytes) return;
+#else
+        encodeLegacyFrame(frame.colors.data(), changed, total, frame.offset, legacyBytes);
+        const std::vector<uint8_t>* bytes = &legacyBytes;
+#endif
+        encodeTimer.stop();
+
+        stageTimer writeTimer(Stage::SerialWrite);
+        const bool sent = transport.write(bytes->data(), bytes->size());
+        const bool flushed = sent && transport.flush();
+        writeTimer.stop();
+        if (flushed) {
+            recordStageSince(Stage::EndToEnd, frame.captured);
+        }
+        else {
+            // État de la bande inconnu : tout renvoyer à la prochaine image
+            errorCount++;
+            resyncRequested = true;
+            if (!sent) return;
+        }
+        lastWritten = frame.colors;
+        frameCount++;
+    }
+
+    void run() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                wake.wait(lock, [this] {
+                    return !running.load() || (middle.load(std::memory_order_acquire) & FRESH);
+                });
+            }
+            if (!running.load()) break;
+            if (takeFrame()) {
+                writeFrame(frames[frontIndex]);
+            }
+        }
+    }
+
+public:
+    ledWriter(byteTransport& output) : transport(output) {
+        writerThread = std::thread(&ledWriter::run, this);
+    }
+
+    ~ledWriter() {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            running = false;
+        }
+        wake.notify_one();
+        if (writerThread.joinable()) {
+            writerThread.join();
+        }
+    }
+
+    ledWriter(const ledWriter&) = delete;
+    ledWriter& operator=(const ledWriter&) = delete;
+
+    // Appelé par la boucle de capture : copie l'état et le rend disponible au thread
+    // d'écriture. Ne bloque jamais sur le port série.
+    void publish(const std::vector<int>& colors, int offset,
+        std::chrono::steady_clock::time_point captured = std::chrono::steady_clock::now()) {
+        LedFrame& back = frames[backIndex];
+        back.colors.assign(colors.begin(), colors.end());
+        back.offset = offset;
+        back.captured = captured;
+
+        const uint8_t previous = middle.exchange(static_cast<uint8_t>(backIndex | FRESH), std::memory_order_acq_rel);
+        if (previous & FRESH) {
+            droppedCount++; // remplacée avant d'avoir été écrite
+        }
+        backIndex = previous & 0x3;
+
+        // Le verrou ne protège que le réveil, pas les données
+        { std::lock_guard<std::mutex> lock(wakeMutex); }
+        wake.notify_one();
+    }
+
+    // Force l'envoi de toute la bande à la prochaine image
+    void resync() {
+        resyncRequested = true;
+    }
+
+    // Compteurs depuis le dernier appel (pour le rapport par seconde)
+    int takeErrors() {
+        return errorCount.exchange(0);
+    }
+
+    int takeDropped() {
+        return droppedCount.exchange(0);
+    }
+
+    int takeWritten() {
+        return frameCount.exchange(0);
+    }
+};
@@ -0,0 +1,280 @@
+﻿#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#ifdef _WIN32
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#endif
+
+// Liaison avec le microcontrôleur des écrans (boutons du bureau). Chaque message est
+// une trame, comme vers la bande de LEDs (voir ledProtocol.cpp) :
+//   [type] [séquence] [charge utile...] [crc16 u16 LE]
+// encodée en COBS puis terminée par 0x00. Une réponse reprend la séquence de la demande.
+//
+// Sans USE_FRAMED_MCU_PROTOCOL, ancien firmware : un octet par commande (0 statut,
+// 1 éteindre, 2 allumer) et une réponse 1 / 4 suivie d'un 0.
+
+enum class McuMessageType : uint8_t {
+    // Microcontrôleur -> PC
+    StatusRequest = 0x01,  // état des écrans demandé
+    DisableMonitor = 0x02, // bouton : éteindre l'écran
+    EnableMonitor = 0x03,  // bouton : allumer l'écran
+    // Dans les deux sens
+    Ping = 0x10,
+    Pong = 0x11,
+    // PC -> microcontrôleur
+    MonitorStatus = 0x81   // charge utile : 1 octet, 1 = écran actif
+};
+
+struct McuMessage {
+    McuMessageType type = McuMessageType::Ping;
+    uint8_t sequence = 0;
+    std::vector<uint8_t> payload;
+};
+
+const size_t MCU_MAX_FRAME = 64; // trame encodée, délimiteur exclu
+
+// Ajoute la trame encodée et son délimiteur à out
+inline void encodeMcuFrame(McuMessageType type, uint8_t sequence, const uint8_t* payload, size_t size, std::vector<uint8_t>& out) {
+    std::vector<uint8_t> raw;
+    raw.reserve(size + 4);
+    raw.push_back(static_cast<uint8_t>(type));
+    raw.push_back(sequence);
+    raw.insert(raw.end(), payload, payload + size);
+    const uint16_t crc = crc16Ccitt(raw.data(), raw.size());
+    raw.push_back(static_cast<uint8_t>(crc & 0xFF));
+    raw.push_back(static_cast<uint8_t>(crc >> 8));
+    cobsEncode(raw.data(), raw.size(), out);
+    out.push_back(0x00);
+}
+
+// Découpe le flux reçu en trames et vérifie leur CRC. Les octets d'une trame trop longue
+// ou corrompue sont ignorés jusqu'au délimiteur suivant.
+class mcuFrameDecoder {
+
+private:
+    std::vector<uint8_t> pending;
+    std::vector<uint8_t> decoded;
+    bool overflow = false;
+    McuMessage message;
+
+public:
+    // onMessage(const McuMessage&) pour chaque trame valide. Retourne le nombre de trames rejetées.
+    template <typename Handler>
+    int feed(const uint8_t* data, size_t size, Handler& onMessage) {
+        int rejected = 0;
+        for (size_t i = 0; i < size; ++i) {
+            if (data[i] != 0x00) {
+                if (pending.size() < MCU_MAX_FRAME) {
+                    pending.push_back(data[i]);
+                }
+                else {
+                    overflow = true;
+                }
+                continue;
+            }
+
+            // Fin de trame
+            if (!pending.empty() || overflow) {
+                decoded.clear();
+                const bool valid = !overflow && cobsDecode(pending.data(), pending.size(), decoded) && decoded.size() >= 4
+                    && crc16Ccitt(decoded.data(), decoded.size() - 2)
+                    == static_cast<uint16_t>(decoded[decoded.size() - 2] | (decoded[decoded.size() - 1] << 8));
+                if (valid) {
+                    message.type = static_cast<McuMessageType>(decoded[0]);
+                    message.sequence = decoded[1];
+                    message.payload.assign(decoded.begin() + 2, decoded.end() - 2);
+                    onMessage(message);
+                }
+                else {
+                    rejected++;
+                }
+            }
+            pending.clear();
+            overflow = false;
+        }
+        return rejected;
+    }
+};
+
+// Ancien firmware : un octet reçu -> commande équivalente
+inline bool legacyMcuMessage(uint8_t received, McuMessage& message) {
+    message.sequence = 0;
+    message.payload.clear();
+    switch (received) {
+    case 0: message.type = McuMessageType::StatusRequest; return true;
+    case 1: message.type = McuMessageType::DisableMonitor; return true;
+    case 2: message.type = McuMessageType::EnableMonitor; return true;
+    default: return false;
+    }
+}
+
+#ifdef _WIN32
+
+// Canal de commandes sur le port du microcontrôleur (ouvert en overlapped). Le thread de
+// lecture dort dans WaitCommEvent jusqu'à l'arrivée d'un octet : pas de réveil périodique,
+// et une commande est traitée dès sa réception. Les handlers s'exécutent sur ce thread.
+// Port débranché : le thread s'arrête et lost() passe à true, le propriétaire rend le
+// port à serialDiscovery et recrée le canal sur le port retrouvé.
+class mcuChannel {
+
+private:
+    HANDLE port;
+    win32SerialTransport reader;  // chaque sens a son événement overlapped
+    win32SerialTransport writer;
+    HANDLE commEvent;
+    HANDLE stopEvent;
+    std::thread readerThread;
+    std::mutex writeMutex;
+    std::vector<std::pair<McuMessageType, std::function<void(const McuMessage&)>>> handlers;
+    std::vector<uint8_t> frame;
+    std::atomic<bool> portLost{ false };
+    int failedWaits = 0;          // échecs consécutifs de WaitCommEvent
+#ifdef USE_FRAMED_MCU_PROTOCOL
+    mcuFrameDecoder decoder;
+#endif
+
+    void dispatch(const McuMessage& message) {
+        if (message.type == McuMessageType::Ping) {
+            send(McuMessageType::Pong, message.sequence, nullptr, 0);
+            return;
+        }
+        for (const auto& handler : handlers) {
+            if (handler.first == message.type) {
+                handler.second(message);
+            }
+        }
+    }
+
+    // Erreur passagère : réessayer sans tourner à vide. Trois de suite : port débranché
+    bool retryAfterError(DWORD error) {
+        std::cerr << "Erreur lecture série: " << error << std::endl;
+        if (++failedWaits >= 3) {
+            portLost = true;
+            return false;
+        }
+        return WaitForSingleObject(stopEvent, 1000) != WAIT_OBJECT_0;
+    }
+
+    // Attend qu'un octet arrive ou que le canal s'arrête. Retourne false à l'arrêt ou
+    // quand le port est perdu.
+    bool waitForData() {
+        OVERLAPPED overlapped = {};
+        overlapped.hEvent = commEvent;
+        ResetEvent(commEvent);
+        DWORD mask = 0;
+        if (!WaitCommEvent(port, &mask, &overlapped) && GetLastError() != ERROR_IO_PENDING) {
+            return retryAfterError(GetLastError());
+        }
+
+        const HANDLE events[2] = { commEvent, stopEvent };
+        if (WaitForMultipleObjects(2, events, FALSE, INFINITE) != WAIT_OBJECT_0) {
+            CancelIoEx(port, &overlapped);
+            DWORD ignored;
+            GetOverlappedResult(port, &overlapped, &ignored, TRUE);
+            return false;
+        }
+        DWORD ignored;
+        if (!GetOverlappedResult(port, &overlapped, &ignored, FALSE)) {
+            return retryAfterError(GetLastError());
+        }
+        failedWaits = 0;
+        return true;
+    }
+
+    void run() {
+        SetCommMask(port, EV_RXCHAR);
+        uint8_t buffer[64];
+        while (waitForData()) {
+            // Vider ce qui est arrivé
+            int n;
+            while ((n = reader.read(buffer, sizeof(buffer), 100)) > 0) {
+#ifdef USE_FRAMED_MCU_PROTOCOL
+                auto onMessage = [this](const McuMessage& message) { dispatch(message); };
+                decoder.feed(buffer, static_cast<size_t>(n), onMessage);
+#else
+                McuMessage message;
+                for (int i = 0; i < n; ++i) {
+                    if (legacyMcuMessage(buffer[i], message)) {
+                        dispatch(message);
+                    }
+                }
+#endif
+            }
+        }
+    }
+
+public:
+    mcuChannel(HANDLE overlappedPort)
+        : port(overlappedPort), reader(overlappedPort), writer(overlappedPort) {
+        commEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+        // ReadFile rend tout de suite ce qui est déjà arrivé : l'attente est dans WaitCommEvent
+        COMMTIMEOUTS timeouts = { 0 };
+        timeouts.ReadIntervalTimeout = MAXDWORD;
+        SetCommTimeouts(port, &timeouts);
+    }
+
+    ~mcuChannel() {
+        stop();
+        if (commEvent) CloseHandle(commEvent);
+        if (stopEvent) CloseHandle(stopEvent);
+    }
+
+    mcuChannel(const mcuChannel&) = delete;
+    mcuChannel& operator=(const mcuChannel&) = delete;
+
+    // À appeler avant start()
+    void on(McuMessageType type, std::function<void(const McuMessage&)> handler) {
+        handlers.emplace_back(type, std::move(handler));
+    }
+
+    void start() {
+        if (!readerThread.joinable() && commEvent && stopEvent) {
+            readerThread = std::thread(&mcuChannel::run, this);
+        }
+    }
+
+    void stop() {
+        if (stopEvent) SetEvent(stopEvent);
+        if (readerThread.joinable()) {
+            readerThread.join();
+        }
+    }
+
+    // Port perdu, le thread de lecture est terminé
+    bool lost() const {
+        return portLost;
+    }
+
+    bool send(McuMessageType type, uint8_t sequence, const uint8_t* payload, size_t size) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        frame.clear();
+        encodeMcuFrame(type, sequence, payload, size, frame);
+        return writer.write(frame.data(), frame.size()) && writer.flush();
+    }
+
+    // Réponse à StatusRequest
+    bool sendMonitorStatus(bool active, uint8_t sequence) {
+#ifdef USE_FRAMED_MCU_PROTOCOL
+        const uint8_t payload = active ? 1 : 0;
+        return send(McuMessageType::MonitorStatus, sequence, &payload, 1);
+#else
+        // L'ancien firmware attend l'état puis, séparément, la fin de réponse
+        std::lock_guard<std::mutex> lock(writeMutex);
+        uint8_t toSend = active ? 1 : 4;
+        bool sent = writer.write(&toSend, 1) && writer.flush();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        toSend = 0;
+        return writer.write(&toSend, 1) && writer.flush() && sent;
+#endif
+    }
+};
+
+#endif
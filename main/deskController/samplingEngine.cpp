@@ -0,0 +1,301 @@
+﻿#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "zoneKernels.cpp"
+#include "workerPool.cpp"
+#include "samplingLayout.cpp"
+#include "dirtyRects.cpp"
+
+// Moteur d'échantillonnage des bords de l'écran, indépendant de l'OS.
+// Aucune dépendance à D3D11/DXGI : il reçoit une image BGRA brute (pointeur + RowPitch)
+// et calcule la couleur moyenne de chaque LED. Le chemin DXGI de deskController.cpp
+// n'est plus qu'un adaptateur qui Map la texture et appelle sample().
+
+// Vue sur une image BGRA 32 bits (octets B, G, R, A), lignes espacées de rowPitch octets
+struct FrameView {
+    const uint8_t* data = nullptr;
+    uint32_t rowPitch = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    // Optionnel (atlas des bordures) : décalage en octets de la ligne source y pour les
+    // colonnes de gauche / de droite. nullptr : image complète, ligne y à y * rowPitch.
+    const int64_t* leftRowOffsets = nullptr;
+    const int64_t* rightRowOffsets = nullptr;
+
+    // Décalage de la ligne source y : pixel (x, y) = data + rowOffset(y, côté) + x * 4
+    int64_t rowOffset(uint32_t y, bool rightSide) const {
+        const int64_t* offsets = rightSide ? rightRowOffsets : leftRowOffsets;
+        return offsets ? offsets[y] : static_cast<int64_t>(y) * rowPitch;
+    }
+};
+
+// Mode d'échantillonnage
+enum class SamplingMode {
+    Buffered, // copie des bordures dans un buffer intermédiaire puis moyenne (référence)
+    Fused     // moyenne par zone directement depuis l'image source, sans buffer intermédiaire
+};
+
+// Paramètres de la bande de LEDs
+struct SamplingParams {
+    int ledX = 0;           // LEDs sur les bords haut et bas
+    int ledY = 0;           // LEDs sur les bords gauche et droit
+    int keepPixels = 0;     // épaisseur de la bande conservée (en pixels réduits)
+    float reduction = 1.0f; // facteur de sous-échantillonnage
+    SamplingFilter filter = SamplingFilter::Nearest;
+    SamplingMode mode = SamplingMode::Fused;
+};
+
+class samplingEngine {
+
+private:
+    SamplingLayout layout;                       // reconstruite uniquement si la configuration change
+    std::vector<int> pixelBuffer;                // utilisé uniquement en mode Buffered
+    SumBgraRowFn sumRow = sumBgraRowKernel().fn; // noyau SIMD choisi au démarrage
+    std::unique_ptr<workerPool> pool;            // créé au premier appel, réutilisé ensuite
+    unsigned participants = 0;                   // threads du calcul, appelant compris ; 0 : selon les cœurs
+
+    // Échantillonnage incrémental : couleurs de la dernière image et zones à recalculer
+    std::vector<int> cachedColors;
+    std::vector<uint8_t> dirtyZones;
+    bool cacheValid = false;   // cachedColors correspond à la géométrie courante
+    bool dirtyPending = false; // le prochain sample() ne recalcule que les zones marquées
+
+public:
+    // Remplit ledColors (taille ledCount(ledX, ledY)) dans l'ordre haut, droite, bas, gauche.
+    // Retourne false si l'image ou les paramètres sont invalides.
+    bool sample(const FrameView& frame, const SamplingParams& params, std::vector<int>& ledColors) {
+        if (!frame.data || frame.width == 0 || frame.height == 0 || frame.rowPitch < frame.width * 4) return false;
+        if (!prepareLayout(frame.width, frame.height, params)) return false;
+
+        ledColors.assign(layout.zones.size(), 0);
+
+        const uint8_t* dirty = (dirtyPending && cacheValid) ? dirtyZones.data() : nullptr;
+        dirtyPending = false;
+
+        if (params.mode == SamplingMode::Buffered) {
+            pixelBuffer.resize(static_cast<size_t>(layout.reducedWidth) * layout.reducedHeight);
+            fillBorders(frame);
+            calcEdges(ledColors, dirty, [this](size_t zone, uint32_t& rSum, uint32_t& gSum, uint32_t& bSum) {
+                sumBufferZone(layout.zones[zone], rSum, gSum, bSum);
+            });
+        }
+        else {
+            // Pas de buffer pleine résolution à remplir ni à remettre à zéro
+            std::vector<int>().swap(pixelBuffer);
+            calcEdges(ledColors, dirty, [this, &frame](size_t zone, uint32_t& rSum, uint32_t& gSum, uint32_t& bSum) {
+                sumFrameZone(frame, layout.zones[zone], layout.isRightZone(zone), rSum, gSum, bSum);
+            });
+        }
+
+        cachedColors = ledColors;
+        cacheValid = true;
+        return true;
+    }
+
+    // Marque les zones touchées par les rectangles modifiés de la prochaine image (en pixels
+    // source) ; le prochain sample() ne recalculera qu'elles. À appeler après prepare().
+    // Retourne le nombre de zones à recalculer (toutes s'il n'y a pas d'image précédente).
+    size_t markDirty(const FrameRect* rects, size_t rectCount) {
+        if (!layout.valid) return 0;
+        if (!cacheValid) {
+            dirtyPending = false;
+            return layout.zones.size();
+        }
+        dirtyPending = true;
+        return markDirtyZones(layout, rects, rectCount, dirtyZones);
+    }
+
+    // Le prochain sample() recalcule toutes les zones (image sans rectangles exploitables)
+    void markAllDirty() {
+        dirtyPending = false;
+    }
+
+    // Rien n'a changé dans les zones : reprend les couleurs de la dernière image.
+    // Retourne false s'il n'y en a pas pour la géométrie courante.
+    bool copyCached(std::vector<int>& ledColors) {
+        dirtyPending = false;
+        if (!layout.valid || !cacheValid) return false;
+        ledColors = cachedColors;
+        return true;
+    }
+
+    // Nombre de threads qui calculent les zones, thread appelant compris. Plusieurs écrans
+    // échantillonnés en même temps se partagent les cœurs au lieu d'avoir chacun un pool
+    // de la taille de la machine. 1 : pas de pool ; 0 : selon les cœurs (par défaut).
+    void setParticipants(unsigned count) {
+        if (count == participants) return;
+        participants = count;
+        pool.reset();
+        layout.valid = false; // découpage en morceaux à refaire pour la nouvelle taille
+    }
+
+    // Force la reconstruction de la géométrie au prochain appel (changement de mode d'écran)
+    void invalidateLayout() {
+        layout.valid = false;
+    }
+
+    // Les couleurs gardées ne sont plus sûres (duplication refaite) : la prochaine image
+    // est échantillonnée en entier, la géométrie est conservée
+    void invalidateCache() {
+        cacheValid = false;
+    }
+
+    // Géométrie pour une image et des paramètres donnés (reconstruite si besoin), ou nullptr.
+    // Permet au chemin de capture de savoir quelles régions copier avant d'avoir l'image.
+    const SamplingLayout* prepare(uint32_t width, uint32_t height, const SamplingParams& params) {
+        return prepareLayout(width, height, params) ? &layout : nullptr;
+    }
+
+private:
+
+    // Reconstruit la géométrie seulement si la configuration a changé
+    bool prepareLayout(uint32_t width, uint32_t height, const SamplingParams& params) {
+#ifdef USE_PARALLEL
+        if (!pool && participants != 1) {
+            pool.reset(new workerPool(participants > 1 ? participants - 1 : 0));
+        }
+        const unsigned targetChunks = pool ? pool->size() * 4 : 1;
+#else
+        const unsigned targetChunks = 1;
+#endif
+        LayoutKey key;
+        key.width = width;
+        key.height = height;
+        key.ledX = params.ledX;
+        key.ledY = params.ledY;
+        key.keepPixels = params.keepPixels;
+        key.reduction = params.reduction;
+        key.filter = params.filter;
+
+        if (layout.valid && layout.key == key) return true;
+        cacheValid = false;
+        dirtyPending = false;
+        return layout.build(key, targetChunks);
+    }
+
+    // Copie un segment [x0, x1) d'une ligne source dans une ligne de pixelBuffer (format 0x00RRGGBB)
+    void fillRowSegment(const FrameView& frame, int64_t rowOffset, int* destRowPtr, uint32_t x0, uint32_t x1) const {
+        const uint32_t* const srcXOffset = layout.srcXOffset.data();
+        for (uint32_t x = x0; x < x1; ++x) {
+            const unsigned char* const pixelPtr = frame.data + (rowOffset + srcXOffset[x]);
+
+            // Lecture séquentielle pour une meilleure performance de cache
+            const unsigned char b = pixelPtr[0];
+            const unsigned char g = pixelPtr[1];
+            const unsigned char r = pixelPtr[2];
+
+            destRowPtr[x] = (r << 16) | (g << 8) | b;
+        }
+    }
+
+    // Copie les quatre bandes de bordure de l'image source dans pixelBuffer
+    void fillBorders(const FrameView& frame) {
+        const uint32_t reducedWidth = layout.reducedWidth;
+        const uint32_t reducedHeight = layout.reducedHeight;
+        const uint32_t leftBound = layout.bandLeft;
+        const uint32_t rightBound = layout.bandRight;
+        const uint32_t topBound = layout.bandTop;
+        const uint32_t bottomBound = layout.bandBottom;
+
+        // 1. Remplir tout le buffer avec des zéros d'un coup (plus rapide qu'une boucle)
+        std::memset(pixelBuffer.data(), 0, pixelBuffer.size() * sizeof(int));
+
+        // 2. Traiter les bordures par segments contigus (meilleure localité de cache)
+        for (uint32_t y = 0; y < reducedHeight; ++y) {
+            const uint32_t baseY = layout.srcRow[y];
+            int* const destRowPtr = pixelBuffer.data() + (static_cast<size_t>(y) * reducedWidth);
+
+            if (y < topBound || y >= bottomBound) {
+                // Bords supérieur et inférieur (y compris les coins)
+                fillRowSegment(frame, frame.rowOffset(baseY, false), destRowPtr, 0, reducedWidth);
+            }
+            else {
+                // Bords gauche et droit
+                fillRowSegment(frame, frame.rowOffset(baseY, false), destRowPtr, 0, leftBound);
+                fillRowSegment(frame, frame.rowOffset(baseY, true), destRowPtr, rightBound, reducedWidth);
+            }
+        }
+    }
+
+    // Somme des composantes d'une zone lue dans pixelBuffer (mode Buffered).
+    // Un pixel 0x00RRGGBB en mémoire little-endian est rangé B, G, R, 0 : même noyau que le BGRA source.
+    void sumBufferZone(const ZoneInfo& zone, uint32_t& rSum, uint32_t& gSum, uint32_t& bSum) const {
+        const int* bufferStart = pixelBuffer.data();
+        for (uint32_t y = zone.startY; y < zone.endY; ++y) {
+            const int* rowStart = bufferStart + (static_cast<size_t>(y) * layout.reducedWidth);
+            sumRow(reinterpret_cast<const uint8_t*>(rowStart + zone.startX), zone.endX - zone.startX, bSum, gSum, rSum);
+        }
+    }
+
+    // Somme des composantes d'une zone lue directement dans l'image source (mode Fused).
+    // Les zones sont toujours contenues dans la bande de bordure, le résultat est donc
+    // identique au mode Buffered sans jamais écrire de buffer pleine résolution.
+    void sumFrameZone(const FrameView& frame, const ZoneInfo& zone, bool rightSide,
+        uint32_t& rSum, uint32_t& gSum, uint32_t& bSum) const {
+        const uint32_t* const srcRow = layout.srcRow.data();
+        const uint32_t* const srcXOffset = layout.srcXOffset.data();
+
+        for (uint32_t y = zone.startY; y < zone.endY; ++y) {
+            const int64_t rowOffset = frame.rowOffset(srcRow[y], rightSide);
+
+            // Sans réduction horizontale les pixels d'un segment de zone sont contigus : noyau SIMD
+            if (layout.contiguousX) {
+                sumRow(frame.data + (rowOffset + zone.startX * 4), zone.endX - zone.startX, bSum, gSum, rSum);
+                continue;
+            }
+
+            for (uint32_t x = zone.startX; x < zone.endX; ++x) {
+                const unsigned char* const pixelPtr = frame.data + (rowOffset + srcXOffset[x]);
+
+                bSum += pixelPtr[0];
+                gSum += pixelPtr[1];
+                rSum += pixelPtr[2];
+            }
+        }
+    }
+
+    // Calcule la moyenne de chaque zone de LED, zoneSum fournissant les sommes de la zone
+    // (dirty : si non nul, seules les zones marquées sont recalculées, les autres viennent du cache)
+    template <typename ZoneSum>
+    void calcEdges(std::vector<int>& ledColors, const uint8_t* dirty, ZoneSum zoneSum) {
+        auto calcZoneAverage = [this, &zoneSum, dirty](std::vector<int>& ledColors, int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                if (dirty && !dirty[i]) {
+                    ledColors[i] = cachedColors[i];
+                    continue;
+                }
+
+                // Éviter la division si la zone est vide
+                if (layout.zonePixels[i] == 0) continue;
+
+                uint32_t rSum = 0, gSum = 0, bSum = 0;
+                zoneSum(static_cast<size_t>(i), rSum, gSum, bSum);
+
+                // Multiplication par la réciproque précalculée au lieu de trois divisions
+                const uint32_t r = layout.divide(rSum, i);
+                const uint32_t g = layout.divide(gSum, i);
+                const uint32_t b = layout.divide(bSum, i);
+                ledColors[i] = static_cast<int>((r << 16) | (g << 8) | b);
+            }
+        };
+
+        // Traitement parallèle sur le pool persistant, par morceaux de coût équivalent
+#ifdef USE_PARALLEL
+        const std::vector<int>& chunkStarts = layout.chunkStarts;
+        auto chunkTask = [&](int chunk) {
+            calcZoneAverage(ledColors, chunkStarts[chunk], chunkStarts[chunk + 1]);
+        };
+        if (pool) {
+            pool->run(static_cast<int>(chunkStarts.size()) - 1, chunkTask);
+        }
+        else {
+            calcZoneAverage(ledColors, 0, static_cast<int>(layout.zones.size()));
+        }
+#else
+        calcZoneAverage(ledColors, 0, static_cast<int>(layout.zones.size()));
+#endif
+    }
+};
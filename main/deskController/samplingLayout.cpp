@@ -0,0 +1,260 @@
+﻿#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Géométrie d'échantillonnage précalculée pour une configuration donnée
+// (taille de l'image, ledX, ledY, keepPixels, reduction). Construite une seule fois
+// puis réutilisée à chaque image : plus d'allocation ni de calcul flottant dans la
+// boucle chaude, seulement quand la configuration ou le mode d'écran change.
+
+// Nombre total de LEDs (haut, droite, bas, gauche)
+inline int ledCount(int ledX, int ledY) {
+    return ledX * 2 + ledY * 2;
+}
+
+// Pixels par zone au plus : les sommes des composantes (255 par pixel) tiennent sur 32 bits,
+// ce que supposent les noyaux et SamplingLayout::divide
+const uint32_t MAX_ZONE_PIXELS = 0xFFFFFFFFu / 255;
+
+// Limites d'une zone de LED sur la grille d'échantillonnage, déjà bornées à la grille
+struct ZoneInfo {
+    uint32_t startX, endX, startY, endY;
+};
+
+// Filtre de réduction
+enum class SamplingFilter {
+    Nearest, // un pixel source par pixel réduit : crénelage sur le texte fin et les lignes d'interface
+    Area     // moyenne de tous les pixels source couverts par la zone, stable quelle que soit la réduction
+};
+
+struct LayoutKey {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    int ledX = 0;
+    int ledY = 0;
+    int keepPixels = 0;
+    float reduction = 0.0f;
+    SamplingFilter filter = SamplingFilter::Nearest;
+
+    bool operator==(const LayoutKey& other) const {
+        return width == other.width && height == other.height && ledX == other.ledX && ledY == other.ledY
+            && keepPixels == other.keepPixels && reduction == other.reduction && filter == other.filter;
+    }
+};
+
+struct SamplingLayout {
+    LayoutKey key;
+    bool valid = false;
+
+    // Grille d'échantillonnage : l'image réduite (Nearest) ou l'image source elle-même
+    // (Area : les zones y sont reportées, chaque pixel source appartient à une seule zone)
+    uint32_t reducedWidth = 0;
+    uint32_t reducedHeight = 0;
+    bool contiguousX = false;             // pas de réduction horizontale : srcX == x
+
+    // Bande conservée sur la grille : lignes [0, bandTop) et [bandBottom, reducedHeight),
+    // colonnes [0, bandLeft) et [bandRight, reducedWidth)
+    uint32_t bandTop = 0;
+    uint32_t bandBottom = 0;
+    uint32_t bandLeft = 0;
+    uint32_t bandRight = 0;
+
+    std::vector<ZoneInfo> zones;          // une zone par LED, dans l'ordre haut, droite, bas, gauche
+    std::vector<uint32_t> zonePixels;     // nombre de pixels échantillonnés par zone
+    std::vector<uint64_t> zoneReciprocal; // 2^32 / zonePixels arrondi, remplace la division
+    std::vector<uint32_t> srcXOffset;     // x réduit -> décalage en octets dans la ligne source
+    std::vector<uint32_t> srcRow;         // y réduit -> ligne source
+    std::vector<int> chunkStarts;         // découpage des zones en morceaux de coût équivalent
+
+    // Construit la géométrie ; retourne false (et invalide la géométrie) si la configuration est impossible
+    bool build(const LayoutKey& newKey, unsigned targetChunks) {
+        valid = false;
+        key = newKey;
+        if (key.width == 0 || key.height == 0) return false;
+        if (key.ledX <= 0 || key.ledY <= 0 || key.keepPixels < 0 || key.reduction <= 0) return false;
+
+        reducedWidth = static_cast<uint32_t>(key.width / key.reduction);
+        reducedHeight = static_cast<uint32_t>(key.height / key.reduction);
+        if (reducedWidth == 0 || reducedHeight == 0) return false;
+        if (static_cast<uint32_t>(key.keepPixels) > reducedWidth ||
+            static_cast<uint32_t>(key.keepPixels) > reducedHeight) return false;
+
+        const float xScale = static_cast<float>(key.width) / reducedWidth;
+        const float yScale = static_cast<float>(key.height) / reducedHeight;
+        contiguousX = reducedWidth == key.width;
+
+        const uint32_t keep = static_cast<uint32_t>(key.keepPixels);
+        bandTop = keep;
+        bandBottom = reducedHeight - keep;
+        bandLeft = keep;
+        bandRight = reducedWidth - keep;
+        buildZones();
+
+        const bool area = key.filter == SamplingFilter::Area;
+        if (area) {
+            // La grille devient l'image source : identité, lignes contiguës pour le noyau SIMD
+            mapZonesToSource();
+            reducedWidth = key.width;
+            reducedHeight = key.height;
+            contiguousX = true;
+        }
+
+        srcXOffset.resize(reducedWidth);
+        for (uint32_t x = 0; x < reducedWidth; ++x) {
+            srcXOffset[x] = area ? x * 4 : static_cast<uint32_t>(x * xScale) * 4;
+        }
+        srcRow.resize(reducedHeight);
+        for (uint32_t y = 0; y < reducedHeight; ++y) {
+            srcRow[y] = area ? y : static_cast<uint32_t>(y * yScale);
+        }
+
+        if (!countZonePixels()) return false;
+        buildChunks(targetChunks);
+        valid = true;
+        return true;
+    }
+
+    // Zone du bord droit (lue dans les colonnes de droite quand l'image est un atlas)
+    bool isRightZone(size_t zone) const {
+        return zone >= static_cast<size_t>(key.ledX) && zone < static_cast<size_t>(key.ledX + key.ledY);
+    }
+
+    // sum / zonePixels[zone] par multiplication, résultat exact (sum < 2^32, voir MAX_ZONE_PIXELS)
+    uint32_t divide(uint32_t sum, size_t zone) const {
+        const uint32_t count = zonePixels[zone];
+        uint32_t quotient = static_cast<uint32_t>((static_cast<uint64_t>(sum) * zoneReciprocal[zone]) >> 32);
+        // La réciproque est arrondie par excès : le quotient peut dépasser de 1
+        if (static_cast<uint64_t>(quotient) * count > sum) {
+            --quotient;
+        }
+        return quotient;
+    }
+
+private:
+
+    // Pré-calcule les limites (en pixels réduits) de la zone de chaque LED
+    void buildZones() {
+        const int ledX = key.ledX;
+        const int ledY = key.ledY;
+        const uint32_t leftBound = bandLeft;
+        const uint32_t rightBound = bandRight;
+        const uint32_t topBound = bandTop;
+        const uint32_t bottomBound = bandBottom;
+
+        float topBottomZoneWidth = static_cast<float>(reducedWidth) / ledX;
+        float leftRightZoneHeight = static_cast<float>(reducedHeight) / ledY;
+
+        zones.resize(ledCount(ledX, ledY));
+        ZoneInfo* topZones = zones.data();
+        ZoneInfo* rightZones = topZones + ledX;
+        ZoneInfo* bottomZones = rightZones + ledY;
+        ZoneInfo* leftZones = bottomZones + ledX;
+
+        for (int i = 0; i < ledX; ++i) {
+            // Zones supérieures
+            topZones[i].startX = static_cast<uint32_t>(i * topBottomZoneWidth);
+            topZones[i].endX = static_cast<uint32_t>((i + 1) * topBottomZoneWidth);
+            topZones[i].startY = 0;
+            topZones[i].endY = topBound;
+
+            // Zones inférieures (de droite à gauche)
+            bottomZones[i].startX = reducedWidth - static_cast<uint32_t>((i + 1) * topBottomZoneWidth);
+            bottomZones[i].endX = reducedWidth - static_cast<uint32_t>(i * topBottomZoneWidth);
+            bottomZones[i].startY = bottomBound;
+            bottomZones[i].endY = reducedHeight;
+        }
+
+        for (int i = 0; i < ledY; ++i) {
+            // Zones droites
+            rightZones[i].startX = rightBound;
+            rightZones[i].endX = reducedWidth;
+            rightZones[i].startY = static_cast<uint32_t>(i * leftRightZoneHeight);
+            rightZones[i].endY = static_cast<uint32_t>((i + 1) * leftRightZoneHeight);
+
+            // Zones gauches (de bas en haut)
+            leftZones[i].startX = 0;
+            leftZones[i].endX = leftBound;
+            leftZones[i].startY = reducedHeight - static_cast<uint32_t>((i + 1) * leftRightZoneHeight);
+            leftZones[i].endY = reducedHeight - static_cast<uint32_t>(i * leftRightZoneHeight);
+        }
+
+        // Borner à l'image réduite une fois pour toutes
+        for (ZoneInfo& zone : zones) {
+            if (zone.endX > reducedWidth) zone.endX = reducedWidth;
+            if (zone.endY > reducedHeight) zone.endY = reducedHeight;
+            if (zone.startX > zone.endX) zone.startX = zone.endX;
+            if (zone.startY > zone.endY) zone.startY = zone.endY;
+        }
+    }
+
+    // Area : pixel réduit x -> pixels source [x * width / reducedWidth, (x + 1) * width / reducedWidth).
+    // En entiers, les bornes de deux zones voisines tombent sur le même pixel source : aucun
+    // pixel n'est compté deux fois ni oublié, et la moyenne d'une zone est celle de sa boîte.
+    void mapZonesToSource() {
+        auto sourceX = [this](uint32_t x) {
+            return static_cast<uint32_t>(static_cast<uint64_t>(x) * key.width / reducedWidth);
+        };
+        auto sourceY = [this](uint32_t y) {
+            return static_cast<uint32_t>(static_cast<uint64_t>(y) * key.height / reducedHeight);
+        };
+        for (ZoneInfo& zone : zones) {
+            zone.startX = sourceX(zone.startX);
+            zone.endX = sourceX(zone.endX);
+            zone.startY = sourceY(zone.startY);
+            zone.endY = sourceY(zone.endY);
+        }
+        bandTop = sourceY(bandTop);
+        bandBottom = sourceY(bandBottom);
+        bandLeft = sourceX(bandLeft);
+        bandRight = sourceX(bandRight);
+    }
+
+    // Nombre de pixels lus par zone et réciproque pour la division. Retourne false si une
+    // zone dépasse MAX_ZONE_PIXELS (très grande image, peu de LEDs et bande très épaisse).
+    bool countZonePixels() {
+        zonePixels.resize(zones.size());
+        zoneReciprocal.resize(zones.size());
+        for (size_t i = 0; i < zones.size(); ++i) {
+            const ZoneInfo& zone = zones[i];
+            const uint32_t count = (zone.endX - zone.startX) * (zone.endY - zone.startY);
+            if (count > MAX_ZONE_PIXELS) return false;
+            zonePixels[i] = count;
+            if (count <= 1) {
+                zoneReciprocal[i] = 1ull << 32;
+            }
+            else {
+                zoneReciprocal[i] = (1ull << 32) / count + 1;
+            }
+        }
+        return true;
+    }
+
+    // Découpe les zones (dans l'ordre des LEDs) en morceaux de coût à peu près égal.
+    // Les bords haut/bas et gauche/droite n'ont ni le même nombre de zones ni la même
+    // forme : un thread par bord était déséquilibré.
+    void buildChunks(unsigned targetChunks) {
+        auto zoneCost = [](const ZoneInfo& zone) -> uint64_t {
+            if (zone.startY >= zone.endY || zone.startX >= zone.endX) return 1;
+            // Coût par ligne (adresse, appel du noyau) en plus des pixels
+            return static_cast<uint64_t>(zone.endY - zone.startY) * (zone.endX - zone.startX + 8);
+        };
+
+        uint64_t totalCost = 0;
+        for (const auto& zone : zones) {
+            totalCost += zoneCost(zone);
+        }
+        const uint64_t target = totalCost / (targetChunks ? targetChunks : 1) + 1;
+
+        chunkStarts.clear();
+        chunkStarts.push_back(0);
+        uint64_t cost = 0;
+        for (size_t i = 0; i < zones.size(); ++i) {
+            cost += zoneCost(zones[i]);
+            if (cost >= target && i + 1 < zones.size()) {
+                chunkStarts.push_back(static_cast<int>(i + 1));
+                cost = 0;
+            }
+        }
+        chunkStarts.push_back(static_cast<int>(zones.size()));
+    }
+};
@@ -1,156 +1,113 @@
-﻿#include <thread>
-#include <fstream>
-#include <codecvt>
+﻿#include <atomic>
+#include <memory>
+#include <thread>
 #include <string>
-#include <sstream>
 
 class screenController {
 
 private:
-    const std::string MONITORS_FILE = "monitors.txt";
-    const std::string MULTIMONITOR_TOOL_PATH = "MultiMonitorTool.exe";
-    bool running = false;
-    std::thread controllerThread;
-    HANDLE serialPort;
+    // Écran piloté et son mode, remplacés d'un coup au rechargement de la configuration
+    std::shared_ptr<const MonitorMode> monitor;
+    topologyCache& displays;                   // état des sorties, mis à jour par WM_DISPLAYCHANGE
+    win32DisplayTopology topology;
+    multiMonitorToolTopology fallbackTopology; // si la topologie ne répond pas dans le processus
+    // Commandes du microcontrôleur ; recréé quand le port est retrouvé, son thread est
+    // arrêté à la destruction. Vide tant que le microcontrôleur est débranché.
+    std::unique_ptr<mcuChannel> channel;
 public:
-    bool monitor_active = false;
-    screenController(HANDLE serialPort_mcu) {
-        running = true;
-        serialPort = serialPort_mcu;
-        controllerThread = std::thread(&screenController::run, this);
+    // Écrit par le thread du microcontrôleur, lu par la boucle principale
+    std::atomic<bool> monitor_active{ false };
+    // serialPort_mcu ouvert en overlapped (voir serialDiscovery.cpp), fermé par l'appelant
+    screenController(HANDLE serialPort_mcu, topologyCache& displayCache, const MonitorMode& mode)
+        : monitor(std::make_shared<MonitorMode>(mode)), displays(displayCache) {
+        std::cout << "Starting thread screenController" << std::endl;
+        connect(serialPort_mcu);
     }
     ~screenController() {
-        running = false; // Signal d'arrêt
-        if (controllerThread.joinable())
-        {
-            controllerThread.join(); // Attend la fin du thread
-        }
+        disconnect(); // Attend la fin du thread
     }
 
-private:
-
-    void check_status_monitor() {
-        boolean _monitor_active = false;
-        try {
-            std::string cmd = MULTIMONITOR_TOOL_PATH + " /stext " + MONITORS_FILE;
-            system(cmd.c_str());
-
-            // Lecture correcte du fichier en UTF-16 avec gestion du BOM
-            std::wifstream wifs(MONITORS_FILE, std::ios::binary);
-            if (!wifs) {
-                throw std::runtime_error("Impossible d'ouvrir monitors.txt");
+    // Nouveau port du microcontrôleur, après disconnect()
+    void connect(HANDLE serialPort_mcu) {
+        std::unique_ptr<mcuChannel> next(new mcuChannel(serialPort_mcu));
+        mcuChannel* target = next.get();
+        target->on(McuMessageType::StatusRequest, [this, target](const McuMessage& message) {
+            std::cout << "Vérification statut écrans" << std::endl;
+            check_status_monitor();
+            target->sendMonitorStatus(monitor_active, message.sequence);
+        });
+        target->on(McuMessageType::DisableMonitor, [this](const McuMessage&) {
+            if (monitorActive()) {
+                disable_monitor();
+            }
+        });
+        target->on(McuMessageType::EnableMonitor, [this](const McuMessage&) {
+            if (!monitorActive()) {
+                enable_monitor();
             }
+        });
+        target->start();
+        channel = std::move(next);
+    }
 
-            // Gérer le BOM UTF-16 si présent
-            wifs.imbue(std::locale(wifs.getloc(),
-                new std::codecvt_utf16<wchar_t, 0x10ffff, std::consume_header>));
+    // Arrête le canal ; le port peut ensuite être fermé
+    void disconnect() {
+        channel.reset();
+    }
 
-            std::wstringstream wss;
-            wss << wifs.rdbuf();
-            std::wstring wContent = wss.str();
+    // Port du microcontrôleur perdu (débranché) ou déjà rendu par disconnect()
+    bool mcuLost() const {
+        return !channel || channel->lost();
+    }
 
-            // Conversion UTF-16 ? UTF-8
-            int utf8Size = WideCharToMultiByte(CP_UTF8, 0, wContent.c_str(), -1, NULL, 0, NULL, NULL);
-            std::string content(utf8Size - 1, '\0');
-            WideCharToMultiByte(CP_UTF8, 0, wContent.c_str(), -1, &content[0], utf8Size, NULL, NULL);
+    // État courant de l'écran d'après le cache, sans interroger le système
+    bool monitorActive() {
+        const std::shared_ptr<const MonitorMode> mode = std::atomic_load(&monitor);
+        const std::shared_ptr<const TopologySnapshot> snapshot = displays.snapshot();
+        const OutputState* output = snapshot->find(mode->deviceName);
+        if (output) {
+            monitor_active = output->active;
+        }
+        return monitor_active;
+    }
 
-            std::istringstream iss(content);
-            std::string line;
+    // Nouveau profil : pris en compte à la prochaine commande du microcontrôleur
+    void setMonitor(const MonitorMode& mode) {
+        std::atomic_store(&monitor, std::shared_ptr<const MonitorMode>(std::make_shared<MonitorMode>(mode)));
+    }
 
-            std::string currentMonitorName;
-            uint8_t flag = 0;
-            bool flag_freq = false;
+private:
 
-            while (std::getline(iss, line)) {
-                // Nettoyer les espaces blancs au début
-                line.erase(0, line.find_first_not_of(" \t\r\n"));
-                //std::cout << line << std::endl;
-                if (line.find("Active            :") == 0) {
-                    std::string activeStatus = line.substr(line.find(":") + 1);
-                    activeStatus.erase(0, activeStatus.find_first_not_of(" \t"));
-                    flag = (activeStatus.find("Yes") != std::string::npos) ? 1 : 2;
-                }
-                else if (line.find("Name              : \\\\.\\DISPLAY3") == 0) {
-                    if (flag == 1) {
-                        _monitor_active = true;
-                        /*if (monitor_active && !flag_freq) {
-                            std::cout << "changing freq" << std::endl;
-                            cmd = MULTIMONITOR_TOOL_PATH + " /SetMonitors \"Name=\\\\.\\DISPLAY3 DisplayFrequency=120\"";
-                            system(cmd.c_str());
-                            std::cout << cmd << std::endl;
-                            //std::this_thread::sleep_for(std::chrono::milliseconds(3000));
-                        }*/
-                    }
-                    else if (flag == 2) {
-                        break;
-                    }
-                }
-                else if (line.find("Frequency         : 120") == 0) {
-                    flag_freq = true;
-                }
-            }
-        } catch(const std::exception& e) {
-            std::cerr << e.what() << std::endl;
+    // Lecture du cache ; MultiMonitorTool seulement si l'écran n'y figure pas
+    void check_status_monitor() {
+        const std::shared_ptr<const MonitorMode> mode = std::atomic_load(&monitor);
+        const std::shared_ptr<const TopologySnapshot> snapshot = displays.snapshot();
+        const OutputState* output = snapshot->find(mode->deviceName);
+        bool active = false;
+        if (output) {
+            active = output->active;
         }
-        monitor_active = _monitor_active;
-
+        else if (!fallbackTopology.queryActive(*mode, active)) {
+            active = false;
+        }
+        monitor_active = active;
     }
 
     void enable_monitor() {
         std::cout << "Enable screen" << std::endl;
-
-        std::string cmd = MULTIMONITOR_TOOL_PATH + " /enable 3 /SetMonitors \"Name=\\\\.\\DISPLAY3 Width=3840 Height=2160 DisplayFrequency=120 PositionX=633 PositionY=-3760\" /SetScale \"\\\\.\\DISPLAY3\" 150";
-        system(cmd.c_str());
+        const std::shared_ptr<const MonitorMode> mode = std::atomic_load(&monitor);
+        if (!topology.enable(*mode)) {
+            fallbackTopology.enable(*mode);
+        }
+        displays.refresh(); // sans attendre WM_DISPLAYCHANGE
     }
 
     void disable_monitor() {
         std::cout << "Disable screen" << std::endl;
-        std::string cmd = MULTIMONITOR_TOOL_PATH + " /disable 3";
-        system(cmd.c_str());
-    }
-
-    void run() {
-        std::cout << "Starting thread screenController" << std::endl;
-        while (running)
-        {
-            DWORD bytesRead;
-            uint8_t received;
-            if (ReadFile(serialPort, &received, 1, &bytesRead, NULL) && bytesRead > 0) {
-                if (received == 0) {
-                    std::cout << "Vérification statut écrans" << std::endl;
-                    check_status_monitor();
-                    uint8_t toSend;
-                    if (monitor_active) {
-                        toSend = 1;
-                    }
-                    else {
-                        toSend = 4;
-                    }
-                    DWORD bytesWritten;
-                    WriteFile(serialPort, &toSend, 1, &bytesWritten, NULL);
-                    FlushFileBuffers(serialPort);
-                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                    toSend = 0;
-                    WriteFile(serialPort, &toSend, 1, &bytesWritten, NULL);
-                    FlushFileBuffers(serialPort);
-                }
-                else if (received == 1 && monitor_active) {
-                    disable_monitor();
-                }
-                else if (received == 2 && !monitor_active) {
-                    enable_monitor();
-                }
-                /*else if (received == 3) {
-                   
-                }
-                else if (received == 4) {
-                    
-                }*/
-            }
-            else if (GetLastError() != ERROR_SUCCESS) {
-                std::cerr << "Erreur lecture série: " << GetLastError() << std::endl;
-            }
-            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        const std::shared_ptr<const MonitorMode> mode = std::atomic_load(&monitor);
+        if (!topology.disable(*mode)) {
+            fallbackTopology.disable(*mode);
         }
+        displays.refresh(); // sans attendre WM_DISPLAYCHANGE
     }
 };
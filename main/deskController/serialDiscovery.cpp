@@ -0,0 +1,346 @@
+﻿#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+// Recherche des périphériques série (bande de LEDs, microcontrôleur). Chaque périphérique
+// est reconnu par un échange court : message d'ouverture envoyé par le PC, réponse
+// d'identification attendue en retour, et rien d'autre. La sonde ne connaît que
+// byteTransport : elle se teste sous Linux avec un pty.
+//
+// Sous Windows, serialDiscovery sonde tous les ports en parallèle, essaie d'abord le
+// dernier port connu de chaque périphérique et continue à chercher en tâche de fond
+// ceux qui manquent (débranchement / rebranchement USB).
+
+enum class SerialDevice : int {
+    Led, // bande de LEDs, 4 Mbit/s
+    Mcu, // microcontrôleur des écrans, 115200 bit/s
+    Count
+};
+
+struct SerialDeviceSpec {
+    const char* name = "";          // nom dans les messages et le cache
+    uint32_t baudRate = 115200;
+    bool overlapped = false;        // mode d'ouverture du port une fois le périphérique trouvé
+    std::vector<uint8_t> hello;     // envoyé par le PC (vide : le périphérique parle en premier)
+    std::vector<uint8_t> idReply;   // réponse d'identification attendue
+    int replyTimeoutMs = 500;       // délai maximal de la réponse
+    int settleMs = 20;              // silence exigé après la réponse
+};
+
+// La bande répond à FF FF par un seul octet nul. Un autre périphérique, ou le
+// microcontrôleur vu à 4 Mbit/s, envoie autre chose ou davantage : la règle « la réponse
+// et rien d'autre » les écarte, là où l'ancien « premier octet nul » les acceptait.
+// Le microcontrôleur répond à un Ping par un Pong (voir mcuChannel.cpp) ; l'ancien
+// firmware envoie de lui-même un octet nul.
+inline SerialDeviceSpec serialDeviceSpec(SerialDevice device) {
+    SerialDeviceSpec spec;
+    switch (device) {
+    case SerialDevice::Led:
+        spec.name = "led";
+        spec.baudRate = 4000000;
+        spec.overlapped = true; // écrit par ledWriter, jamais bloquant sans limite
+        spec.hello = { 0xFF, 0xFF };
+        spec.idReply = { 0x00 };
+        spec.replyTimeoutMs = 500;
+        break;
+    case SerialDevice::Mcu:
+        spec.name = "mcu";
+        spec.baudRate = 115200;
+        spec.overlapped = true; // lu par mcuChannel
+#ifdef USE_FRAMED_MCU_PROTOCOL
+        encodeMcuFrame(McuMessageType::Ping, 0, nullptr, 0, spec.hello);
+        encodeMcuFrame(McuMessageType::Pong, 0, nullptr, 0, spec.idReply);
+        spec.replyTimeoutMs = 500;
+#else
+        spec.idReply = { 0x00 };
+        spec.replyTimeoutMs = 5000;
+#endif
+        break;
+    default:
+        break;
+    }
+    return spec;
+}
+
+// Envoie le message d'ouverture et attend exactement la réponse d'identification, suivie
+// de settleMs de silence. Un octet inattendu rejette le port tout de suite.
+inline bool probeDevice(byteTransport& port, const SerialDeviceSpec& spec) {
+    if (spec.idReply.empty()) return false;
+    if (!spec.hello.empty() && !port.write(spec.hello.data(), spec.hello.size())) {
+        return false;
+    }
+
+    auto remainingMs = [](std::chrono::steady_clock::time_point deadline) {
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        return left > 0 ? static_cast<int>(left) : 0;
+    };
+
+    uint8_t buffer[64];
+    size_t matched = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(spec.replyTimeoutMs);
+    bool replied = false;
+    while (true) {
+        const int timeoutMs = remainingMs(deadline);
+        if (timeoutMs == 0) return replied; // fin du silence après la réponse, ou pas de réponse
+        const int n = port.read(buffer, sizeof(buffer), timeoutMs);
+        if (n < 0) return false;
+        for (int i = 0; i < n; ++i) {
+            if (replied || buffer[i] != spec.idReply[matched]) return false;
+            if (++matched == spec.idReply.size()) {
+                // Réponse complète : plus rien ne doit arriver pendant settleMs
+                replied = true;
+                deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(spec.settleMs);
+            }
+        }
+    }
+}
+
+// Dernier port connu de chaque périphérique, une ligne nom=port dans un fichier texte
+class serialPortCache {
+
+private:
+    std::string path;
+    std::string ports[static_cast<int>(SerialDevice::Count)];
+
+public:
+    explicit serialPortCache(const std::string& file) : path(file) {
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            const size_t separator = line.find('=');
+            if (separator == std::string::npos) continue;
+            const std::string name = line.substr(0, separator);
+            for (int d = 0; d < static_cast<int>(SerialDevice::Count); ++d) {
+                if (name == serialDeviceSpec(static_cast<SerialDevice>(d)).name) {
+                    ports[d] = line.substr(separator + 1);
+                }
+            }
+        }
+    }
+
+    const std::string& get(SerialDevice device) const {
+        return ports[static_cast<int>(device)];
+    }
+
+    void set(SerialDevice device, const std::string& port) {
+        if (ports[static_cast<int>(device)] == port) return;
+        ports[static_cast<int>(device)] = port;
+        std::ofstream out(path, std::ios::trunc);
+        for (int d = 0; d < static_cast<int>(SerialDevice::Count); ++d) {
+            if (!ports[d].empty()) {
+                out << serialDeviceSpec(static_cast<SerialDevice>(d)).name << '=' << ports[d] << '\n';
+            }
+        }
+    }
+};
+
+#ifdef _WIN32
+
+class serialDiscovery {
+
+private:
+    static const int DEVICE_COUNT = static_cast<int>(SerialDevice::Count);
+    const std::chrono::seconds FALLBACK_RESCAN = std::chrono::seconds(10); // sans changement de la liste des ports
+
+    enum class PortState { Missing, Found, InUse };
+
+    struct DeviceSlot {
+        SerialDeviceSpec spec;
+        PortState state = PortState::Missing;
+        HANDLE port = INVALID_HANDLE_VALUE; // trouvé, pas encore pris par waitFor / tryTake
+        std::string portName;               // port trouvé ou utilisé
+    };
+
+    DeviceSlot devices[DEVICE_COUNT];
+    serialPortCache cache;
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool running = true;
+    bool rescanRequested = true; // première recherche, ou périphérique perdu
+    std::thread watcher;
+
+    bool portTaken(const std::string& portName) {
+        for (const DeviceSlot& slot : devices) {
+            if (slot.state != PortState::Missing && slot.portName == portName) return true;
+        }
+        return false;
+    }
+
+    // Sonde un port pour chacun des périphériques encore recherchés, le périphérique
+    // dont c'est le dernier port connu en premier
+    void probePort(const std::string& portName) {
+        int order[DEVICE_COUNT];
+        int count = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (int d = 0; d < DEVICE_COUNT; ++d) {
+                if (devices[d].state == PortState::Missing && cache.get(static_cast<SerialDevice>(d)) == portName) order[count++] = d;
+            }
+            for (int d = 0; d < DEVICE_COUNT; ++d) {
+                if (devices[d].state == PortState::Missing && cache.get(static_cast<SerialDevice>(d)) != portName) order[count++] = d;
+            }
+        }
+
+        for (int i = 0; i < count; ++i) {
+            const int d = order[i];
+            const SerialDeviceSpec& spec = devices[d].spec;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!running || devices[d].state != PortState::Missing) continue;
+            }
+
+            // Sonde toujours en overlapped : chaque lecture a son propre délai
+            HANDLE port = openSerialPort(portName, spec.baudRate, true);
+            if (port == INVALID_HANDLE_VALUE) return; // absent ou déjà ouvert ailleurs
+
+            bool identified;
+            {
+                win32SerialTransport transport(port, static_cast<DWORD>(spec.replyTimeoutMs));
+                identified = probeDevice(transport, spec);
+            }
+            if (!identified) {
+                CloseHandle(port);
+                continue;
+            }
+            if (!spec.overlapped) {
+                CloseHandle(port);
+                port = openSerialPort(portName, spec.baudRate, false);
+                if (port == INVALID_HANDLE_VALUE) return;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (devices[d].state != PortState::Missing) {
+                CloseHandle(port); // trouvé entre-temps sur un autre port
+                return;
+            }
+            std::cout << "Serial " << spec.name << " found on " << portName << std::endl;
+            devices[d].state = PortState::Found;
+            devices[d].port = port;
+            devices[d].portName = portName;
+            cache.set(static_cast<SerialDevice>(d), portName);
+            changed.notify_all();
+            return;
+        }
+    }
+
+    // Un thread par port libre, tous sondés en même temps
+    void scan(const std::vector<std::string>& portNames) {
+        std::vector<std::thread> probes;
+        for (const std::string& portName : portNames) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (portTaken(portName)) continue;
+            }
+            probes.emplace_back(&serialDiscovery::probePort, this, portName);
+        }
+        for (std::thread& probe : probes) {
+            probe.join();
+        }
+    }
+
+    void run() {
+        std::vector<std::string> knownPorts;
+        auto lastScan = std::chrono::steady_clock::time_point();
+        std::unique_lock<std::mutex> lock(mutex);
+        while (running) {
+            bool missing = false;
+            for (const DeviceSlot& slot : devices) {
+                missing = missing || slot.state == PortState::Missing;
+            }
+
+            if (missing) {
+                // Nouvelle recherche quand un port apparaît ou disparaît, sinon de temps en temps
+                const bool requested = rescanRequested;
+                rescanRequested = false;
+                lock.unlock();
+                std::vector<std::string> ports = listSerialPorts();
+                const auto now = std::chrono::steady_clock::now();
+                if (requested || ports != knownPorts || now - lastScan >= FALLBACK_RESCAN) {
+                    scan(ports);
+                    knownPorts = ports;
+                    lastScan = std::chrono::steady_clock::now();
+                }
+                lock.lock();
+            }
+            if (running && !rescanRequested) {
+                changed.wait_for(lock, std::chrono::seconds(1));
+            }
+        }
+    }
+
+public:
+    serialDiscovery(const std::string& cacheFile = "serialPorts.txt") : cache(cacheFile) {
+        for (int d = 0; d < DEVICE_COUNT; ++d) {
+            devices[d].spec = serialDeviceSpec(static_cast<SerialDevice>(d));
+        }
+        watcher = std::thread(&serialDiscovery::run, this);
+    }
+
+    ~serialDiscovery() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        changed.notify_all();
+        if (watcher.joinable()) {
+            watcher.join();
+        }
+        for (DeviceSlot& slot : devices) {
+            if (slot.state == PortState::Found) {
+                CloseHandle(slot.port);
+            }
+        }
+    }
+
+    serialDiscovery(const serialDiscovery&) = delete;
+    serialDiscovery& operator=(const serialDiscovery&) = delete;
+
+    // Attend que le périphérique soit trouvé et retourne son port ; l'appelant le ferme
+    HANDLE waitFor(SerialDevice device) {
+        DeviceSlot& slot = devices[static_cast<int>(device)];
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&] { return slot.state == PortState::Found || !running; });
+        if (slot.state != PortState::Found) return INVALID_HANDLE_VALUE;
+        slot.state = PortState::InUse;
+        HANDLE port = slot.port;
+        slot.port = INVALID_HANDLE_VALUE;
+        return port;
+    }
+
+    // Sans attendre : le port s'il a été trouvé depuis le dernier lost()
+    HANDLE tryTake(SerialDevice device) {
+        DeviceSlot& slot = devices[static_cast<int>(device)];
+        std::lock_guard<std::mutex> lock(mutex);
+        if (slot.state != PortState::Found) return INVALID_HANDLE_VALUE;
+        slot.state = PortState::InUse;
+        HANDLE port = slot.port;
+        slot.port = INVALID_HANDLE_VALUE;
+        return port;
+    }
+
+    // Le port pris ne répond plus : nouvelle recherche en tâche de fond. L'appelant ferme
+    // l'ancien port avant, sinon il reste occupé pour la sonde.
+    void lost(SerialDevice device) {
+        DeviceSlot& slot = devices[static_cast<int>(device)];
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (slot.state != PortState::InUse) return;
+            std::cout << "Serial " << slot.spec.name << " lost on " << slot.portName << std::endl;
+            slot.state = PortState::Missing;
+            slot.portName.clear();
+            rescanRequested = true;
+        }
+        changed.notify_all();
+    }
+};
+
+#endif
@@ -2,135 +2,89 @@
 #include <fstream>
 #include <string>
 #include <chrono>
-#include <thread> 
+#include <cstring>
+#include <thread>
+#include <vector>
 
+// Ouverture et énumération des ports COM (Windows). L'identification des périphériques
+// est dans serialDiscovery.cpp.
 
-HANDLE findSerial_led() {
-    std::cout << "Looking for LED Serial" << std::endl;
-    for (int i = 1; i <= 10; ++i) { // Teste COM1 à COM256
-        std::string portName = "\\\\.\\COM" + std::to_string(i);
-        std::cout << "Trying COM" << portName << std::endl;
-
-        HANDLE tempPort = CreateFileA(portName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
-        if (tempPort == INVALID_HANDLE_VALUE) {
-            continue; // Port non disponible
-        }
+// Ouvre et configure un port série (8N1). overlapped : ouverture avec FILE_FLAG_OVERLAPPED,
+// les lectures retournent dès qu'un octet est arrivé (voir win32SerialTransport::read).
+// Retourne INVALID_HANDLE_VALUE si le port est absent, occupé ou refuse la configuration.
+HANDLE openSerialPort(const std::string& portName, DWORD baudRate, bool overlapped) {
+    HANDLE port = CreateFileA(portName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING,
+        overlapped ? FILE_FLAG_OVERLAPPED : 0, NULL);
+    if (port == INVALID_HANDLE_VALUE) {
+        return INVALID_HANDLE_VALUE; // Port non disponible
+    }
 
-        // Configure les paramètres du port
-        DCB dcbSerialParams = { 0 };
-        dcbSerialParams.DCBlength = sizeof(dcbSerialParams);
-        if (!GetCommState(tempPort, &dcbSerialParams)) {
-            CloseHandle(tempPort);
-            continue;
-        }
-        dcbSerialParams.BaudRate = 4000000;
-        dcbSerialParams.ByteSize = 8;
-        dcbSerialParams.StopBits = ONESTOPBIT;
-        dcbSerialParams.Parity = NOPARITY;
-        if (!SetCommState(tempPort, &dcbSerialParams)) {
-            CloseHandle(tempPort);
-            continue;
-        }
+    // Configure les paramètres du port
+    DCB dcbSerialParams = { 0 };
+    dcbSerialParams.DCBlength = sizeof(dcbSerialParams);
+    if (!GetCommState(port, &dcbSerialParams)) {
+        CloseHandle(port);
+        return INVALID_HANDLE_VALUE;
+    }
+    dcbSerialParams.BaudRate = baudRate;
+    dcbSerialParams.ByteSize = 8;
+    dcbSerialParams.StopBits = ONESTOPBIT;
+    dcbSerialParams.Parity = NOPARITY;
+    if (!SetCommState(port, &dcbSerialParams)) {
+        CloseHandle(port);
+        return INVALID_HANDLE_VALUE;
+    }
 
-        // Configure les timeouts
-        COMMTIMEOUTS timeouts = { 0 };
+    // Configure les timeouts
+    COMMTIMEOUTS timeouts = { 0 };
+    if (overlapped) {
+        // Retourne tout de suite ce qui est déjà arrivé, sinon le premier octet reçu
+        timeouts.ReadIntervalTimeout = MAXDWORD;
+        timeouts.ReadTotalTimeoutMultiplier = MAXDWORD;
+        timeouts.ReadTotalTimeoutConstant = 1000;
+    }
+    else {
         timeouts.ReadIntervalTimeout = 50;
         timeouts.ReadTotalTimeoutConstant = 1000;
         timeouts.ReadTotalTimeoutMultiplier = 10;
-        if (!SetCommTimeouts(tempPort, &timeouts)) {
-            CloseHandle(tempPort);
-            continue;
-        }
-        std::cout << "Connected to: " << portName << std::endl;
-
-        uint8_t data[2] = { 0xFF, 0xFF };
-        DWORD bytesWritten;
-
-        // Fixed: Changed 'y' to 'tempPort'
-        if (WriteFile(tempPort, data, 2, &bytesWritten, NULL)) {
-            std::cout << "Sent FF FF" << std::endl;
-        }
-        else {
-            CloseHandle(tempPort);
-            continue;
-        }
-
-        auto start = std::chrono::system_clock::now();
-        int tryingTime = 500; // 5 sec
-
-        while (std::chrono::duration_cast<std::chrono::milliseconds>(
-            std::chrono::system_clock::now() - start).count() < tryingTime) {
-            DWORD bytesRead;
-            uint8_t received;
-            if (ReadFile(tempPort, &received, 1, &bytesRead, NULL) && bytesRead > 0) {
-                std::cout << "recieve " << portName << std::endl;
-                if (received == 0) {
-                    std::cout << "found on " << portName << std::endl;
-                    return tempPort;
-                }
-            }
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        }
-        CloseHandle(tempPort);
     }
-    std::cout << "Serial MCU unfound." << std::endl;
-    return INVALID_HANDLE_VALUE;
-}
+    if (!SetCommTimeouts(port, &timeouts)) {
+        CloseHandle(port);
+        return INVALID_HANDLE_VALUE;
+    }
 
-HANDLE findSerial_mcu() {
-    std::cout << "Looking for MCU Serial" << std::endl;
-    for (int i = 1; i <= 10; ++i) { // Teste COM1 à COM256
-        std::string portName = "\\\\.\\COM" + std::to_string(i);
-        std::cout << "Trying COM" << portName << std::endl;
+    // Octets reçus avant l'ouverture : ils ne répondent à rien
+    PurgeComm(port, PURGE_RXCLEAR | PURGE_TXCLEAR);
+    return port;
+}
 
-        HANDLE tempPort = CreateFileA(portName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
-        if (tempPort == INVALID_HANDLE_VALUE) {
-            continue; // Port non disponible
-        }
+// Ports COM présents (QueryDosDevice), sous la forme \\.\COMn. Si l'énumération échoue,
+// COM1 à COM10 comme avant.
+std::vector<std::string> listSerialPorts() {
+    std::vector<std::string> ports;
+    std::vector<char> devices(16 * 1024);
+    DWORD length = 0;
+    while ((length = QueryDosDeviceA(NULL, devices.data(), static_cast<DWORD>(devices.size()))) == 0
+        && GetLastError() == ERROR_INSUFFICIENT_BUFFER && devices.size() < 1024 * 1024) {
+        devices.resize(devices.size() * 2);
+    }
 
-        // Configure les paramètres du port
-        DCB dcbSerialParams = { 0 };
-        dcbSerialParams.DCBlength = sizeof(dcbSerialParams);
-        if (!GetCommState(tempPort, &dcbSerialParams)) {
-            CloseHandle(tempPort);
-            continue;
+    // Liste de noms terminés par un zéro, finie par un zéro supplémentaire
+    for (const char* name = devices.data(); length > 0 && *name; name += std::strlen(name) + 1) {
+        if (std::strncmp(name, "COM", 3) != 0 || name[3] == '\0') continue;
+        bool digits = true;
+        for (const char* c = name + 3; *c; ++c) {
+            digits = digits && *c >= '0' && *c <= '9';
         }
-        dcbSerialParams.BaudRate = 115200;
-        dcbSerialParams.ByteSize = 8;
-        dcbSerialParams.StopBits = ONESTOPBIT;
-        dcbSerialParams.Parity = NOPARITY;
-        if (!SetCommState(tempPort, &dcbSerialParams)) {
-            CloseHandle(tempPort);
-            continue;
+        if (digits) {
+            ports.push_back(std::string("\\\\.\\") + name);
         }
+    }
 
-        // Configure les timeouts
-        COMMTIMEOUTS timeouts = { 0 };
-        timeouts.ReadIntervalTimeout = 50;
-        timeouts.ReadTotalTimeoutConstant = 1000;
-        timeouts.ReadTotalTimeoutMultiplier = 10;
-        if (!SetCommTimeouts(tempPort, &timeouts)) {
-            CloseHandle(tempPort);
-            continue;
-        }
-        std::cout << "Connected to: " << portName << std::endl;
-        auto start = std::chrono::system_clock::now();
-        int tryingTime = 5000; // 5 sec
-
-        while (std::chrono::duration_cast<std::chrono::milliseconds>(
-            std::chrono::system_clock::now() - start).count() < tryingTime) {
-            DWORD bytesRead;
-            uint8_t received;
-            if (ReadFile(tempPort, &received, 1, &bytesRead, NULL) && bytesRead > 0) {
-                if (received == 0) {
-                    std::cout << "found on " << portName << std::endl;
-                    return tempPort;
-                }
-            }
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (ports.empty()) {
+        for (int i = 1; i <= 10; ++i) {
+            ports.push_back("\\\\.\\COM" + std::to_string(i));
         }
-        CloseHandle(tempPort);
     }
-    std::cout << "Serial MCU unfound." << std::endl;
-    return INVALID_HANDLE_VALUE;
+    return ports;
 }
@@ -0,0 +1,169 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+// Transport d'octets vers la bande de LEDs. Le thread d'écriture ne connaît que cette
+// interface : sous Windows c'est le port COM en E/S overlapped, ailleurs un simple
+// descripteur de fichier (pty, pipe) pour les essais hors machine.
+
+class byteTransport {
+
+public:
+    virtual ~byteTransport() {}
+
+    // Écrit tout le tampon ; retourne false en cas d'erreur ou d'écriture partielle
+    virtual bool write(const uint8_t* data, size_t size) = 0;
+
+    // Attend que les octets soient réellement partis
+    virtual bool flush() {
+        return true;
+    }
+
+    // Lit au plus size octets en attendant au plus waitMs. Retourne le nombre d'octets
+    // lus (0 si rien n'est arrivé à temps) ou -1 en cas d'erreur.
+    virtual int read(uint8_t*, size_t, int) {
+        return -1;
+    }
+};
+
+#ifdef _WIN32
+
+// Port COM ouvert avec FILE_FLAG_OVERLAPPED. Chaque opération attend sa fin avec un
+// délai maximal, puis est annulée : un périphérique bloqué ne fige plus le thread.
+class win32SerialTransport : public byteTransport {
+
+private:
+    HANDLE port;
+    HANDLE event;
+    DWORD timeoutMs;
+
+    // Attend la fin d'une opération overlapped démarrée par ReadFile/WriteFile
+    bool complete(BOOL started, OVERLAPPED& overlapped, DWORD& transferred) {
+        if (!started && GetLastError() != ERROR_IO_PENDING) {
+            return false;
+        }
+        if (WaitForSingleObject(event, timeoutMs) != WAIT_OBJECT_0) {
+            CancelIoEx(port, &overlapped);
+            GetOverlappedResult(port, &overlapped, &transferred, TRUE);
+            return false;
+        }
+        return GetOverlappedResult(port, &overlapped, &transferred, FALSE) != FALSE;
+    }
+
+public:
+    win32SerialTransport(HANDLE overlappedPort, DWORD timeout = 1000)
+        : port(overlappedPort), timeoutMs(timeout) {
+        event = CreateEvent(NULL, TRUE, FALSE, NULL);
+    }
+
+    ~win32SerialTransport() {
+        if (event) {
+            CloseHandle(event);
+        }
+    }
+
+    win32SerialTransport(const win32SerialTransport&) = delete;
+    win32SerialTransport& operator=(const win32SerialTransport&) = delete;
+
+    bool write(const uint8_t* data, size_t size) override {
+        if (!event) return false;
+        OVERLAPPED overlapped = {};
+        overlapped.hEvent = event;
+        ResetEvent(event);
+
+        DWORD written = 0;
+        const DWORD toWrite = static_cast<DWORD>(size);
+        const BOOL started = WriteFile(port, data, toWrite, &written, &overlapped);
+        if (!complete(started, overlapped, written)) {
+            return false;
+        }
+        return written == toWrite;
+    }
+
+    // Les COMMTIMEOUTS du port s'appliquent aussi ; une lecture encore en cours après
+    // waitMs est annulée et retourne les octets déjà reçus
+    int read(uint8_t* data, size_t size, int waitMs) override {
+        if (!event) return -1;
+        OVERLAPPED overlapped = {};
+        overlapped.hEvent = event;
+        ResetEvent(event);
+
+        DWORD bytesRead = 0;
+        const BOOL started = ReadFile(port, data, static_cast<DWORD>(size), &bytesRead, &overlapped);
+        if (!started && GetLastError() != ERROR_IO_PENDING) {
+            return -1;
+        }
+        if (WaitForSingleObject(event, static_cast<DWORD>(waitMs)) != WAIT_OBJECT_0) {
+            CancelIoEx(port, &overlapped);
+        }
+        if (!GetOverlappedResult(port, &overlapped, &bytesRead, TRUE) && GetLastError() != ERROR_OPERATION_ABORTED) {
+            return -1;
+        }
+        return static_cast<int>(bytesRead);
+    }
+
+    bool flush() override {
+        return FlushFileBuffers(port) != FALSE;
+    }
+};
+
+#else
+
+// Descripteur de fichier (pty, pipe, fichier) : utilisé par les essais sous Linux
+class fdTransport : public byteTransport {
+
+private:
+    int fd;
+    int timeoutMs;
+
+public:
+    fdTransport(int fileDescriptor, int timeout = 1000) : fd(fileDescriptor), timeoutMs(timeout) {}
+
+    bool write(const uint8_t* data, size_t size) override {
+        size_t sent = 0;
+        while (sent < size) {
+            const ssize_t n = ::write(fd, data + sent, size - sent);
+            if (n > 0) {
+                sent += static_cast<size_t>(n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                pollfd pfd = { fd, POLLOUT, 0 };
+                if (poll(&pfd, 1, timeoutMs) > 0) continue;
+            }
+            return false;
+        }
+        return true;
+    }
+
+    bool flush() override {
+        // tcdrain n'a de sens que sur un terminal (pty, port série)
+        return !isatty(fd) || tcdrain(fd) == 0;
+    }
+
+    int read(uint8_t* data, size_t size, int waitMs) override {
+        while (true) {
+            pollfd pfd = { fd, POLLIN, 0 };
+            const int ready = poll(&pfd, 1, waitMs);
+            if (ready < 0 && errno == EINTR) continue;
+            if (ready < 0) return -1;
+            if (ready == 0) return 0;
+
+            const ssize_t n = ::read(fd, data, size);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+            return n < 0 ? -1 : static_cast<int>(n);
+        }
+    }
+};
+
+#endif
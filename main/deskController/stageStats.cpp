@@ -0,0 +1,202 @@
+﻿#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Latence par étape de la chaîne (capture, échantillonnage, couleurs, encodage, écriture
+// série) : un histogramme sans verrou par étape, alimenté depuis n'importe quel thread,
+// dont on tire p50 / p95 / p99 / max. Désactivé, un point de mesure ne coûte qu'une
+// lecture atomique relâchée (pas d'appel à l'horloge).
+
+enum class Stage : int {
+    Capture,         // captureScreen complet
+    Acquire,         // AcquireNextFrame
+    Copy,            // lancement des copies GPU
+    Map,             // Map de la texture de staging (attente du GPU)
+    Sample,          // échantillonnage des bordures
+    ColorCorrection, // tables gamma / calibration
+    ChangeDetection, // seuil perceptuel et tramage
+    Encode,          // trame LED
+    SerialWrite,     // écriture + flush sur le port
+    EndToEnd,        // début de capture -> octets partis sur le port
+    Count
+};
+
+inline const char* stageName(Stage stage) {
+    switch (stage) {
+    case Stage::Capture: return "capture";
+    case Stage::Acquire: return "acquire";
+    case Stage::Copy: return "copy";
+    case Stage::Map: return "map";
+    case Stage::Sample: return "sample";
+    case Stage::ColorCorrection: return "color";
+    case Stage::ChangeDetection: return "delta";
+    case Stage::Encode: return "encode";
+    case Stage::SerialWrite: return "serial";
+    case Stage::EndToEnd: return "end-to-end";
+    default: return "?";
+    }
+}
+
+// Résumé d'un histogramme, en microsecondes
+struct StageSummary {
+    uint64_t count = 0;
+    uint32_t p50 = 0;
+    uint32_t p95 = 0;
+    uint32_t p99 = 0;
+    uint32_t max = 0;
+};
+
+// Histogramme log-linéaire : 8 sous-intervalles par octave, erreur relative < 12,5 %
+class latencyHistogram {
+
+private:
+    static const int SUB_BITS = 3;
+    static const int SUBS = 1 << SUB_BITS;
+    static const int BUCKETS = (32 - SUB_BITS + 1) * SUBS;
+
+    std::atomic<uint32_t> buckets[BUCKETS];
+    std::atomic<uint32_t> maxValue;
+
+    static int highestBit(uint32_t value) {
+        int bit = 0;
+        if (value >= 1u << 16) { value >>= 16; bit += 16; }
+        if (value >= 1u << 8) { value >>= 8; bit += 8; }
+        if (value >= 1u << 4) { value >>= 4; bit += 4; }
+        if (value >= 1u << 2) { value >>= 2; bit += 2; }
+        if (value >= 1u << 1) { bit += 1; }
+        return bit;
+    }
+
+    static int bucketOf(uint32_t value) {
+        if (value < static_cast<uint32_t>(SUBS)) return static_cast<int>(value);
+        const int shift = highestBit(value) - SUB_BITS;
+        return (shift + 1) * SUBS + static_cast<int>((value >> shift) & (SUBS - 1));
+    }
+
+    // Plus grande valeur du bucket
+    static uint32_t bucketUpperBound(int bucket) {
+        if (bucket < SUBS) return static_cast<uint32_t>(bucket);
+        const int shift = bucket / SUBS - 1;
+        const uint64_t lower = static_cast<uint64_t>(SUBS + bucket % SUBS) << shift;
+        const uint64_t upper = lower + (1ull << shift) - 1;
+        return upper > 0xFFFFFFFFull ? 0xFFFFFFFFu : static_cast<uint32_t>(upper);
+    }
+
+public:
+    latencyHistogram() {
+        for (auto& bucket : buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        maxValue.store(0, std::memory_order_relaxed);
+    }
+
+    void record(uint32_t micros) {
+        buckets[bucketOf(micros)].fetch_add(1, std::memory_order_relaxed);
+        uint32_t current = maxValue.load(std::memory_order_relaxed);
+        while (micros > current && !maxValue.compare_exchange_weak(current, micros, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Résumé depuis le dernier reset ; reset = true remet les compteurs à zéro au passage
+    StageSummary summary(bool reset) {
+        uint32_t counts[BUCKETS];
+        StageSummary result;
+        for (int i = 0; i < BUCKETS; ++i) {
+            counts[i] = reset ? buckets[i].exchange(0, std::memory_order_relaxed) : buckets[i].load(std::memory_order_relaxed);
+            result.count += counts[i];
+        }
+        result.max = reset ? maxValue.exchange(0, std::memory_order_relaxed) : maxValue.load(std::memory_order_relaxed);
+        if (result.count == 0) return result;
+
+        auto percentile = [&](uint64_t perMille) -> uint32_t {
+            const uint64_t rank = (result.count * perMille + 999) / 1000;
+            uint64_t seen = 0;
+            for (int i = 0; i < BUCKETS; ++i) {
+                seen += counts[i];
+                if (seen >= rank) {
+                    const uint32_t upper = bucketUpperBound(i);
+                    return upper < result.max ? upper : result.max;
+                }
+            }
+            return result.max;
+        };
+        result.p50 = percentile(500);
+        result.p95 = percentile(950);
+        result.p99 = percentile(990);
+        return result;
+    }
+};
+
+inline std::atomic<bool>& stageStatsFlag() {
+    static std::atomic<bool> enabled(false);
+    return enabled;
+}
+
+inline bool stageStatsEnabled() {
+    return stageStatsFlag().load(std::memory_order_relaxed);
+}
+
+inline void setStageStatsEnabled(bool enabled) {
+    stageStatsFlag().store(enabled, std::memory_order_relaxed);
+}
+
+inline latencyHistogram& stageHistogram(Stage stage) {
+    static latencyHistogram histograms[static_cast<int>(Stage::Count)];
+    return histograms[static_cast<int>(stage)];
+}
+
+inline void recordStage(Stage stage, std::chrono::steady_clock::duration elapsed) {
+    if (!stageStatsEnabled()) return;
+    const long long micros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    stageHistogram(stage).record(micros < 0 ? 0u : (micros > 0xFFFFFFFFll ? 0xFFFFFFFFu : static_cast<uint32_t>(micros)));
+}
+
+inline void recordStageSince(Stage stage, std::chrono::steady_clock::time_point start) {
+    if (!stageStatsEnabled()) return;
+    recordStage(stage, std::chrono::steady_clock::now() - start);
+}
+
+// Mesure la durée d'une portée
+class stageTimer {
+
+private:
+    Stage stage;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit stageTimer(Stage measured) : stage(measured), active(stageStatsEnabled()) {
+        if (active) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~stageTimer() {
+        stop();
+    }
+
+    stageTimer(const stageTimer&) = delete;
+    stageTimer& operator=(const stageTimer&) = delete;
+
+    // Arrête la mesure avant la fin de la portée
+    void stop() {
+        if (active) {
+            recordStageSince(stage, start);
+            active = false;
+        }
+    }
+};
+
+// Une ligne par étape mesurée depuis le dernier appel (compteurs remis à zéro)
+inline void logStageStats(std::ostream& out) {
+    for (int i = 0; i < static_cast<int>(Stage::Count); ++i) {
+        const Stage stage = static_cast<Stage>(i);
+        const StageSummary summary = stageHistogram(stage).summary(true);
+        if (summary.count == 0) continue;
+        out << "[stats] " << stageName(stage) << ": n=" << summary.count
+            << " p50=" << summary.p50 << "us p95=" << summary.p95 << "us p99=" << summary.p99
+            << "us max=" << summary.max << "us" << std::endl;
+    }
+}
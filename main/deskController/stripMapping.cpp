@@ -0,0 +1,121 @@
+﻿#include <cstdint>
+#include <vector>
+
+// Une seule bande physique alimentée par plusieurs écrans : chaque écran est échantillonné
+// avec ses propres paramètres, puis des segments de ses LEDs logiques (ordre haut, droite,
+// bas, gauche) sont recopiés bout à bout dans la bande. Indépendant de l'OS.
+//
+// Exemple, trois écrans côte à côte et une bande qui fait le tour de l'ensemble :
+//   gauche : bord gauche puis haut, milieu : haut, droit : haut, droite puis bas...
+// Chaque segment peut déborder de la fin de l'écran sur son début (gauche -> haut).
+
+// Échantillonnage d'un écran
+struct ScreenZones {
+    int screenId = 0;
+    int ledX = 0;
+    int ledY = 0;
+    int keepPixels = 140;
+    float reduction = 1.0f;
+    SamplingFilter filter = SamplingFilter::Nearest;
+
+    bool operator==(const ScreenZones& other) const {
+        return screenId == other.screenId && ledX == other.ledX && ledY == other.ledY
+            && keepPixels == other.keepPixels && reduction == other.reduction && filter == other.filter;
+    }
+};
+
+// Portion de la bande : count LEDs de l'écran screens[screen] à partir de firstLed
+struct StripSegment {
+    int screen = 0;         // index dans StripMapping::screens
+    int firstLed = 0;       // première LED logique de l'écran
+    int count = 0;
+    bool reversed = false;  // bande posée dans l'autre sens sur ce bord
+
+    bool operator==(const StripSegment& other) const {
+        return screen == other.screen && firstLed == other.firstLed && count == other.count && reversed == other.reversed;
+    }
+};
+
+struct StripMapping {
+    std::vector<ScreenZones> screens;
+    std::vector<StripSegment> segments; // dans l'ordre de la bande physique
+
+    // Nombre de LEDs de la bande
+    int ledCount() const {
+        int total = 0;
+        for (const StripSegment& segment : segments) {
+            total += segment.count;
+        }
+        return total;
+    }
+
+    bool valid() const {
+        if (screens.empty() || segments.empty()) return false;
+        for (size_t i = 0; i < screens.size(); ++i) {
+            const ScreenZones& zones = screens[i];
+            if (zones.screenId < 0 || zones.ledX <= 0 || zones.ledY <= 0 || zones.reduction <= 0) return false;
+            // Un écran n'est capturé qu'une fois par image (un seul thread par écran)
+            for (size_t j = 0; j < i; ++j) {
+                if (screens[j].screenId == zones.screenId) return false;
+            }
+        }
+        for (const StripSegment& segment : segments) {
+            if (segment.screen < 0 || segment.screen >= static_cast<int>(screens.size())) return false;
+            const ScreenZones& zones = screens[segment.screen];
+            const int screenLeds = ::ledCount(zones.ledX, zones.ledY);
+            if (segment.count <= 0 || segment.count > screenLeds) return false;
+            if (segment.firstLed < 0 || segment.firstLed >= screenLeds) return false;
+        }
+        return true;
+    }
+
+    bool operator==(const StripMapping& other) const {
+        return screens == other.screens && segments == other.segments;
+    }
+};
+
+// Un écran, toute sa bordure : le comportement d'origine
+inline StripMapping singleScreenMapping(int screenId, int ledX, int ledY, int keepPixels, float reduction) {
+    StripMapping mapping;
+    ScreenZones zones;
+    zones.screenId = screenId;
+    zones.ledX = ledX;
+    zones.ledY = ledY;
+    zones.keepPixels = keepPixels;
+    zones.reduction = reduction;
+    mapping.screens.push_back(zones);
+
+    StripSegment segment;
+    segment.count = ledCount(ledX, ledY);
+    mapping.segments.push_back(segment);
+    return mapping;
+}
+
+// Recopie les couleurs des écrans dans la bande. colors[i] / sizes[i] : résultat de
+// l'écran screens[i], ou nullptr si sa capture a échoué ; ses segments gardent alors
+// les couleurs de l'image précédente. Une bande d'une autre taille (nouvelle disposition)
+// repart du noir : rien de l'ancienne disposition ne reste affiché. Retourne false si
+// aucun écran n'a de couleurs.
+inline bool stitchStrip(const StripMapping& mapping, const int* const* colors, const int* sizes, std::vector<int>& strip) {
+    const size_t total = static_cast<size_t>(mapping.ledCount());
+    if (strip.size() != total) {
+        strip.assign(total, 0);
+    }
+
+    bool any = false;
+    int position = 0;
+    for (const StripSegment& segment : mapping.segments) {
+        const int* source = colors[segment.screen];
+        const int size = sizes[segment.screen];
+        if (source && size > 0) {
+            int* out = strip.data() + position;
+            for (int k = 0; k < segment.count; ++k) {
+                const int led = (segment.firstLed + k) % size;
+                out[segment.reversed ? segment.count - 1 - k : k] = source[led];
+            }
+            any = true;
+        }
+        position += segment.count;
+    }
+    return any;
+}
@@ -0,0 +1,77 @@
+﻿#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+// Tests de parseMonitorReport sur des rapports MultiMonitorTool (/stext) gardés dans
+// tests/fixtures, déjà convertis de l'UTF-16 en UTF-8 comme le fait
+// multiMonitorToolTopology (fins de ligne CRLF conservées).
+//
+// Aucune dépendance à Windows :
+//   Linux : g++ -std=c++14 tests/monitorReportTest.cpp -o monitorReportTest
+//   MSVC  : cl /EHsc tests\monitorReportTest.cpp
+// Code de sortie non nul si un cas échoue.
+
+#include "../displayTopology.cpp"
+
+struct ReportCase {
+    const char* fixture;
+    bool expectedFound;
+    bool expectedActive;
+};
+
+// Dossier des fixtures, à côté de ce fichier
+static std::string fixturePath(const char* name) {
+    std::string directory = __FILE__;
+    const size_t slash = directory.find_last_of("\\/");
+    directory = slash == std::string::npos ? std::string(".") : directory.substr(0, slash);
+    return directory + "/fixtures/" + name;
+}
+
+static bool readFixture(const char* name, std::string& content) {
+    std::ifstream in(fixturePath(name), std::ios::binary);
+    if (!in) return false;
+    std::ostringstream text;
+    text << in.rdbuf();
+    content = text.str();
+    return true;
+}
+
+int main() {
+    const std::string deviceName = "\\\\.\\DISPLAY3";
+    const ReportCase cases[] = {
+        { "display3Active.txt", true, true },
+        { "display3Inactive.txt", true, false },
+        { "display3Missing.txt", false, false },
+        // DISPLAY30 actif listé avant DISPLAY3 éteint : seul le nom exact compte
+        { "display30BeforeDisplay3.txt", true, false },
+    };
+
+    int failures = 0;
+    for (const ReportCase& test : cases) {
+        std::string report;
+        if (!readFixture(test.fixture, report)) {
+            std::printf("FAIL %s: fixture introuvable\n", test.fixture);
+            failures++;
+            continue;
+        }
+
+        bool active = false;
+        const bool found = parseMonitorReport(report, deviceName, active);
+        const bool passed = found == test.expectedFound && (!found || active == test.expectedActive);
+        std::printf("%s %s: found %d active %d\n", passed ? "ok  " : "FAIL", test.fixture, found, active);
+        if (!passed) failures++;
+    }
+
+    // Dans le même rapport, DISPLAY30 est bien trouvé sous son propre nom
+    std::string report;
+    if (readFixture("display30BeforeDisplay3.txt", report)) {
+        bool active = false;
+        const bool found = parseMonitorReport(report, "\\\\.\\DISPLAY30", active);
+        const bool passed = found && active;
+        std::printf("%s DISPLAY30 exact: found %d active %d\n", passed ? "ok  " : "FAIL", found, active);
+        if (!passed) failures++;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
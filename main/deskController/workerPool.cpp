@@ -0,0 +1,175 @@
+﻿#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Pool de threads persistant : les threads sont créés une seule fois au lieu de
+// quatre std::thread par image. run() découpe le travail en morceaux répartis
+// entre les participants (le thread appelant compris) ; un participant qui a
+// fini sa part vole des morceaux à la fin de la file des autres.
+class workerPool {
+
+private:
+    // File d'un participant : intervalle [next, end) de morceaux encodé dans un
+    // seul mot 64 bits, pour que le propriétaire (par l'avant) et les voleurs
+    // (par l'arrière) se synchronisent par un simple compare-and-swap.
+    // Remplie jusqu'à 64 octets : deux files voisines ne partagent jamais une ligne de
+    // cache. Pas d'alignas, que new[] ne garantit pas avant C++17 (C4316 / -Waligned-new).
+    struct WorkQueue {
+        std::atomic<uint64_t> range{ 0 };
+        char padding[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    static uint64_t packRange(uint32_t next, uint32_t end) {
+        return (static_cast<uint64_t>(next) << 32) | end;
+    }
+
+    std::vector<std::thread> threads;
+    std::vector<WorkQueue> queues; // une file par thread + une pour l'appelant
+    unsigned participantCount = 1;
+
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+    uint64_t generation = 0;
+    unsigned finishedWorkers = 0;
+    bool stopping = false;
+
+    // Tâche en cours, sans allocation : pointeur de fonction + contexte
+    void (*taskFn)(void*, int) = nullptr;
+    void* taskContext = nullptr;
+
+public:
+    // threadCount = 0 : un thread par cœur disponible, moins le thread appelant
+    explicit workerPool(unsigned threadCount = 0) {
+        if (threadCount == 0) {
+            unsigned cores = std::thread::hardware_concurrency();
+            threadCount = cores > 1 ? cores - 1 : 1;
+            if (threadCount > 7) threadCount = 7;
+        }
+        participantCount = threadCount + 1;
+        std::vector<WorkQueue>(participantCount).swap(queues);
+
+        threads.reserve(threadCount);
+        for (unsigned i = 0; i < threadCount; ++i) {
+            threads.emplace_back(&workerPool::workerLoop, this, i + 1);
+        }
+    }
+
+    ~workerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeCondition.notify_all();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    workerPool(const workerPool&) = delete;
+    workerPool& operator=(const workerPool&) = delete;
+
+    // Nombre de participants (threads du pool + thread appelant)
+    unsigned size() const {
+        return participantCount;
+    }
+
+    // Exécute task(chunk) pour chaque chunk de [0, chunkCount) et attend la fin.
+    // Doit être appelé depuis un seul thread à la fois.
+    template <typename Task>
+    void run(int chunkCount, Task& task) {
+        if (chunkCount <= 0) return;
+
+        // Répartition initiale en parts contiguës à peu près égales
+        const uint32_t count = static_cast<uint32_t>(chunkCount);
+        for (unsigned p = 0; p < participantCount; ++p) {
+            uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(count) * p / participantCount);
+            uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(count) * (p + 1) / participantCount);
+            queues[p].range.store(packRange(begin, end), std::memory_order_relaxed);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            taskFn = [](void* context, int chunk) { (*static_cast<Task*>(context))(chunk); };
+            taskContext = &task;
+            finishedWorkers = 0;
+            ++generation;
+        }
+        wakeCondition.notify_all();
+
+        process(0);
+
+        // Attendre que tous les threads aient quitté la tâche avant de rendre la main
+        std::unique_lock<std::mutex> lock(mutex);
+        doneCondition.wait(lock, [this] { return finishedWorkers == threads.size(); });
+        taskFn = nullptr;
+        taskContext = nullptr;
+    }
+
+private:
+
+    void workerLoop(unsigned self) {
+        uint64_t seenGeneration = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeCondition.wait(lock, [&] { return stopping || generation != seenGeneration; });
+                if (stopping) return;
+                seenGeneration = generation;
+            }
+
+            process(self);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++finishedWorkers;
+            }
+            doneCondition.notify_one();
+        }
+    }
+
+    // Vide sa propre file puis vole chez les autres jusqu'à ce qu'il ne reste rien
+    void process(unsigned self) {
+        int chunk;
+        while (popFront(queues[self], chunk)) {
+            taskFn(taskContext, chunk);
+        }
+
+        for (unsigned offset = 1; offset < participantCount; ++offset) {
+            WorkQueue& victim = queues[(self + offset) % participantCount];
+            while (stealBack(victim, chunk)) {
+                taskFn(taskContext, chunk);
+            }
+        }
+    }
+
+    static bool popFront(WorkQueue& queue, int& chunk) {
+        uint64_t range = queue.range.load(std::memory_order_acquire);
+        while (true) {
+            uint32_t next = static_cast<uint32_t>(range >> 32);
+            uint32_t end = static_cast<uint32_t>(range);
+            if (next >= end) return false;
+            if (queue.range.compare_exchange_weak(range, packRange(next + 1, end), std::memory_order_acq_rel)) {
+                chunk = static_cast<int>(next);
+                return true;
+            }
+        }
+    }
+
+    static bool stealBack(WorkQueue& queue, int& chunk) {
+        uint64_t range = queue.range.load(std::memory_order_acquire);
+        while (true) {
+            uint32_t next = static_cast<uint32_t>(range >> 32);
+            uint32_t end = static_cast<uint32_t>(range);
+            if (next >= end) return false;
+            if (queue.range.compare_exchange_weak(range, packRange(next, end - 1), std::memory_order_acq_rel)) {
+                chunk = static_cast<int>(end - 1);
+                return true;
+            }
+        }
+    }
+};
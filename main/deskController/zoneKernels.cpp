@@ -0,0 +1,177 @@
+﻿#include <cstdint>
+#include <vector>
+
+// Noyaux de sommation des composantes B/G/R sur un segment de pixels BGRA 32 bits contigus.
+// Trois implémentations (scalaire, SSE2, AVX2) choisies au démarrage via CPUID ; les
+// versions SIMD sont validées contre la version scalaire avant d'être retenues.
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define ZONE_KERNELS_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define ZONE_KERNELS_TARGET_SSE2
+#define ZONE_KERNELS_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define ZONE_KERNELS_TARGET_SSE2 __attribute__((target("sse2")))
+#define ZONE_KERNELS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Ajoute aux sommes les composantes des count pixels à partir de pixels (octets B, G, R, A)
+typedef void (*SumBgraRowFn)(const uint8_t* pixels, uint32_t count, uint32_t& bSum, uint32_t& gSum, uint32_t& rSum);
+
+inline void sumBgraRowScalar(const uint8_t* pixels, uint32_t count, uint32_t& bSum, uint32_t& gSum, uint32_t& rSum) {
+    for (uint32_t x = 0; x < count; ++x) {
+        const uint8_t* const pixelPtr = pixels + (x * 4);
+        bSum += pixelPtr[0];
+        gSum += pixelPtr[1];
+        rSum += pixelPtr[2];
+    }
+}
+
+#ifdef ZONE_KERNELS_X86
+
+// Chaque canal est isolé par masque puis sommé avec PSADBW contre zéro :
+// une instruction additionne les 8 octets de chaque moitié de registre.
+ZONE_KERNELS_TARGET_SSE2
+inline void sumBgraRowSse2(const uint8_t* pixels, uint32_t count, uint32_t& bSum, uint32_t& gSum, uint32_t& rSum) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i maskB = _mm_set1_epi32(0x000000FF);
+    const __m128i maskG = _mm_set1_epi32(0x0000FF00);
+    const __m128i maskR = _mm_set1_epi32(0x00FF0000);
+    __m128i accB = zero, accG = zero, accR = zero;
+
+    uint32_t x = 0;
+    for (; x + 4 <= count; x += 4) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + (x * 4)));
+        accB = _mm_add_epi64(accB, _mm_sad_epu8(_mm_and_si128(v, maskB), zero));
+        accG = _mm_add_epi64(accG, _mm_sad_epu8(_mm_and_si128(v, maskG), zero));
+        accR = _mm_add_epi64(accR, _mm_sad_epu8(_mm_and_si128(v, maskR), zero));
+    }
+
+    bSum += static_cast<uint32_t>(_mm_cvtsi128_si32(accB) + _mm_cvtsi128_si32(_mm_srli_si128(accB, 8)));
+    gSum += static_cast<uint32_t>(_mm_cvtsi128_si32(accG) + _mm_cvtsi128_si32(_mm_srli_si128(accG, 8)));
+    rSum += static_cast<uint32_t>(_mm_cvtsi128_si32(accR) + _mm_cvtsi128_si32(_mm_srli_si128(accR, 8)));
+
+    sumBgraRowScalar(pixels + (x * 4), count - x, bSum, gSum, rSum);
+}
+
+ZONE_KERNELS_TARGET_AVX2
+inline uint32_t horizontalSumAvx2(__m256i acc) {
+    const __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+}
+
+ZONE_KERNELS_TARGET_AVX2
+inline void sumBgraRowAvx2(const uint8_t* pixels, uint32_t count, uint32_t& bSum, uint32_t& gSum, uint32_t& rSum) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i maskB = _mm256_set1_epi32(0x000000FF);
+    const __m256i maskG = _mm256_set1_epi32(0x0000FF00);
+    const __m256i maskR = _mm256_set1_epi32(0x00FF0000);
+    __m256i accB = zero, accG = zero, accR = zero;
+
+    uint32_t x = 0;
+    for (; x + 8 <= count; x += 8) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + (x * 4)));
+        accB = _mm256_add_epi64(accB, _mm256_sad_epu8(_mm256_and_si256(v, maskB), zero));
+        accG = _mm256_add_epi64(accG, _mm256_sad_epu8(_mm256_and_si256(v, maskG), zero));
+        accR = _mm256_add_epi64(accR, _mm256_sad_epu8(_mm256_and_si256(v, maskR), zero));
+    }
+
+    bSum += horizontalSumAvx2(accB);
+    gSum += horizontalSumAvx2(accG);
+    rSum += horizontalSumAvx2(accR);
+
+    sumBgraRowScalar(pixels + (x * 4), count - x, bSum, gSum, rSum);
+}
+
+inline void cpuidQuery(int leaf, int subLeaf, int regs[4]) {
+#ifdef _MSC_VER
+    __cpuidex(regs, leaf, subLeaf);
+#else
+    unsigned int a = 0, b = 0, c = 0, d = 0;
+    __cpuid_count(leaf, subLeaf, a, b, c, d);
+    regs[0] = static_cast<int>(a);
+    regs[1] = static_cast<int>(b);
+    regs[2] = static_cast<int>(c);
+    regs[3] = static_cast<int>(d);
+#endif
+}
+
+inline bool cpuHasSse2() {
+    int regs[4];
+    cpuidQuery(1, 0, regs);
+    return (regs[3] & (1 << 26)) != 0;
+}
+
+inline bool cpuHasAvx2() {
+    int regs[4];
+    cpuidQuery(0, 0, regs);
+    if (regs[0] < 7) return false;
+
+    // AVX nécessite aussi que l'OS sauvegarde les registres YMM (OSXSAVE + XCR0)
+    cpuidQuery(1, 0, regs);
+    const bool osxsave = (regs[2] & (1 << 27)) != 0;
+    const bool avx = (regs[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx) return false;
+
+#ifdef _MSC_VER
+    const unsigned long long xcr0 = _xgetbv(0);
+#else
+    unsigned int eax = 0, edx = 0;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    const unsigned long long xcr0 = (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+    if ((xcr0 & 0x6) != 0x6) return false;
+
+    cpuidQuery(7, 0, regs);
+    return (regs[1] & (1 << 5)) != 0;
+}
+
+#endif
+
+// Vérifie qu'un noyau donne exactement les mêmes sommes que la version scalaire,
+// sur des longueurs et des alignements variés
+inline bool validateSumBgraRow(SumBgraRowFn kernel) {
+    std::vector<uint8_t> pixels(4 * 1031 + 16);
+    uint32_t seed = 0x12345678u;
+    for (auto& p : pixels) {
+        seed = seed * 1664525u + 1013904223u;
+        p = static_cast<uint8_t>(seed >> 24);
+    }
+
+    for (uint32_t offset = 0; offset < 4; ++offset) {
+        for (uint32_t count = 0; count <= 1024; count += (count < 40 ? 1 : 97)) {
+            uint32_t b0 = 0, g0 = 0, r0 = 0, b1 = 0, g1 = 0, r1 = 0;
+            sumBgraRowScalar(pixels.data() + offset * 4, count, b0, g0, r0);
+            kernel(pixels.data() + offset * 4, count, b1, g1, r1);
+            if (b0 != b1 || g0 != g1 || r0 != r1) return false;
+        }
+    }
+    return true;
+}
+
+struct SumBgraRowKernel {
+    SumBgraRowFn fn;
+    const char* name;
+};
+
+inline SumBgraRowKernel selectSumBgraRow() {
+#ifdef ZONE_KERNELS_X86
+    if (cpuHasAvx2() && validateSumBgraRow(sumBgraRowAvx2)) {
+        return { sumBgraRowAvx2, "avx2" };
+    }
+    if (cpuHasSse2() && validateSumBgraRow(sumBgraRowSse2)) {
+        return { sumBgraRowSse2, "sse2" };
+    }
+#endif
+    return { sumBgraRowScalar, "scalar" };
+}
+
+// Noyau retenu pour cette machine, choisi une seule fois
+inline const SumBgraRowKernel& sumBgraRowKernel() {
+    static const SumBgraRowKernel kernel = selectSumBgraRow();
+    return kernel;
+}